@@ -63,6 +63,37 @@ static IOTHUB_DEVICE_CLIENT_LL_HANDLE iothubClientHandle = NULL;
 /// </summary>
 static bool iothubAuthenticated = false;
 
+/// <summary>
+///     Arena the Device Twin documents are parsed into; it is reset after each update so
+///     the documents never fragment the heap.
+/// </summary>
+static JSON_Arena *twinArena = NULL;
+
+/// <summary>
+///     Names of the Device Twin document being parsed, shared by the objects that repeat them.
+///     It is only set while parsing into twinArena and cleared with it, since the names come from
+///     the cloud and a table kept across updates would grow with every new one.
+/// </summary>
+static JSON_Intern_Table *twinNames = NULL;
+
+/// <summary>
+///     The desired properties as last received, on the heap. Complete Device Twin updates replace
+///     them and partial updates are merged into them, so that only changes reach the application.
+/// </summary>
+static JSON_Value *desiredPropertiesCache = NULL;
+
+/// <summary>
+///     Writer the reported properties are serialized into; its buffer is reused by every report.
+/// </summary>
+static JSON_Writer *twinReportWriter = NULL;
+
+/// <summary>
+///     The reported properties as last sent, on the heap. Reports only send what differs from
+///     them, and nothing when a property keeps its value. Dropped when a report is rejected, so
+///     that the next one sends every property again.
+/// </summary>
+static JSON_Value *reportedPropertiesCache = NULL;
+
 /// <summary>
 ///     Used to set the keepalive period over MQTT to 20 seconds.
 /// </summary>
@@ -375,6 +406,27 @@ void AzureIoT_DoPeriodicTasks(void)
     }
 }
 
+/// <summary>
+///     Hands a message over to the IoT Hub client and destroys it.
+/// </summary>
+/// <param name="messageHandle">The message to send, NULL when it could not be created.</param>
+static void SendMessageHandle(IOTHUB_MESSAGE_HANDLE messageHandle)
+{
+    if (messageHandle == 0) {
+        LogMessage("WARNING: unable to create a new IoTHubMessage\n");
+        return;
+    }
+
+    if (IoTHubDeviceClient_LL_SendEventAsync(iothubClientHandle, messageHandle, sendMessageCallback,
+                                             /*&callback_param*/ 0) != IOTHUB_CLIENT_OK) {
+        LogMessage("WARNING: failed to hand over the message to IoTHubClient\n");
+    } else {
+        LogMessage("INFO: IoTHubClient accepted the message for delivery\n");
+    }
+
+    IoTHubMessage_Destroy(messageHandle);
+}
+
 /// <summary>
 ///     Creates and enqueues a message to be delivered the IoT Hub. The message is not actually
 ///     sent immediately, but it is sent on the next invocation of AzureIoT_DoPeriodicTasks().
@@ -387,21 +439,35 @@ void AzureIoT_SendMessage(const char *messagePayload)
         return;
     }
 
-    IOTHUB_MESSAGE_HANDLE messageHandle = IoTHubMessage_CreateFromString(messagePayload);
+    SendMessageHandle(IoTHubMessage_CreateFromString(messagePayload));
+}
 
-    if (messageHandle == 0) {
-        LogMessage("WARNING: unable to create a new IoTHubMessage\n");
+/// <summary>
+///     Creates and enqueues a binary message to be delivered the IoT Hub, like
+///     AzureIoT_SendMessage().
+/// </summary>
+/// <param name="messagePayload">The payload of the message to send.</param>
+/// <param name="messagePayloadSize">The size of the payload.</param>
+/// <param name="contentType">The media type of the payload, e.g. "application/cbor".</param>
+void AzureIoT_SendMessageWithContentType(const unsigned char *messagePayload,
+                                         size_t messagePayloadSize, const char *contentType)
+{
+    if (iothubClientHandle == NULL) {
+        LogMessage("WARNING: IoT Hub client not initialized\n");
         return;
     }
 
-    if (IoTHubDeviceClient_LL_SendEventAsync(iothubClientHandle, messageHandle, sendMessageCallback,
-                                             /*&callback_param*/ 0) != IOTHUB_CLIENT_OK) {
-        LogMessage("WARNING: failed to hand over the message to IoTHubClient\n");
-    } else {
-        LogMessage("INFO: IoTHubClient accepted the message for delivery\n");
+    IOTHUB_MESSAGE_HANDLE messageHandle =
+        IoTHubMessage_CreateFromByteArray(messagePayload, messagePayloadSize);
+    if (messageHandle != 0 &&
+        IoTHubMessage_SetContentTypeSystemProperty(messageHandle, contentType) !=
+            IOTHUB_MESSAGE_OK) {
+        LogMessage("WARNING: unable to set the content type of the IoTHubMessage\n");
+        IoTHubMessage_Destroy(messageHandle);
+        return;
     }
 
-    IoTHubMessage_Destroy(messageHandle);
+    SendMessageHandle(messageHandle);
 }
 
 /// <summary>
@@ -422,6 +488,10 @@ static void reportStatusCallback(int result, void *context)
 {
     LogMessage("INFO: Device Twin reported properties update result: HTTP status code %d\n",
                result);
+    if (result < 200 || result >= 300) {
+        json_value_free(reportedPropertiesCache);
+        reportedPropertiesCache = NULL;
+    }
     if (deviceTwinConfirmationCb)
         deviceTwinConfirmationCb(result);
 }
@@ -438,8 +508,19 @@ void AzureIoT_TwinReportState(const char *propertyName, size_t propertyValue)
         return;
     }
 
-    char *reportedPropertiesString = NULL;
-    JSON_Value *reportedPropertiesRootJson = json_value_init_object();
+    if (twinReportWriter == NULL) {
+        twinReportWriter = json_writer_create(0);
+        if (twinReportWriter == NULL) {
+            LogMessage("ERROR: could not create the JSON writer for Device Twin reporting.\n");
+            return;
+        }
+    }
+
+    // The reported properties once this one is set, and the patch that gets them there.
+    JSON_Value *reportedPropertiesPatchJson = NULL;
+    JSON_Value *reportedPropertiesRootJson = reportedPropertiesCache != NULL
+                                                 ? json_value_deep_copy(reportedPropertiesCache)
+                                                 : json_value_init_object();
     if (reportedPropertiesRootJson == NULL) {
         LogMessage("ERROR: could not create the JSON_Value for Device Twin reporting.\n");
         return;
@@ -457,29 +538,45 @@ void AzureIoT_TwinReportState(const char *propertyName, size_t propertyValue)
         goto cleanup;
     }
 
-    reportedPropertiesString = json_serialize_to_string(reportedPropertiesRootJson);
-    if (reportedPropertiesString == NULL) {
+    if (reportedPropertiesCache == NULL) {
+        reportedPropertiesPatchJson = json_value_deep_copy(reportedPropertiesRootJson);
+    } else {
+        reportedPropertiesPatchJson =
+            json_diff(reportedPropertiesCache, reportedPropertiesRootJson);
+    }
+    if (reportedPropertiesPatchJson == NULL) {
+        LogMessage("ERROR: could not compute the Device Twin reported properties patch.\n");
+        goto cleanup;
+    }
+    if (json_object_get_count(json_value_get_object(reportedPropertiesPatchJson)) == 0) {
+        LogMessage("INFO: Reported property '%s' already has value %zu, not sent.\n",
+                   propertyName, propertyValue);
+        goto cleanup;
+    }
+
+    if (json_writer_serialize(twinReportWriter, reportedPropertiesPatchJson) != JSONSuccess) {
         LogMessage(
             "ERROR: could not serialize the JSON payload to string for Device "
             "Twin reporting.\n");
         goto cleanup;
     }
 
+    // The SDK copies the reported state, the writer buffer can be reused right away.
     if (IoTHubDeviceClient_LL_SendReportedState(
-            iothubClientHandle, (unsigned char *)reportedPropertiesString,
-            strlen(reportedPropertiesString), reportStatusCallback, 0) != IOTHUB_CLIENT_OK) {
+            iothubClientHandle, (const unsigned char *)json_writer_get_string(twinReportWriter),
+            json_writer_get_length(twinReportWriter), reportStatusCallback,
+            0) != IOTHUB_CLIENT_OK) {
         LogMessage("ERROR: failed to set reported property '%s'.\n", propertyName);
     } else {
         LogMessage("INFO: Set reported property '%s' to value %d.\n", propertyName, propertyValue);
+        json_value_free(reportedPropertiesCache);
+        reportedPropertiesCache = reportedPropertiesRootJson;
+        reportedPropertiesRootJson = NULL;
     }
 
 cleanup:
-    if (reportedPropertiesRootJson != NULL) {
-        json_value_free(reportedPropertiesRootJson);
-    }
-    if (reportedPropertiesString != NULL) {
-        json_free_serialized_string(reportedPropertiesString);
-    }
+    json_value_free(reportedPropertiesPatchJson);
+    json_value_free(reportedPropertiesRootJson);
 }
 
 /// <summary>
@@ -530,23 +627,14 @@ static IOTHUBMESSAGE_DISPOSITION_RESULT receiveMessageCallback(IOTHUB_MESSAGE_HA
         return IOTHUBMESSAGE_REJECTED;
     }
 
-    // 'buffer' is not zero terminated.
-    unsigned char *str_msg = (unsigned char *)malloc(size + 1);
-    if (str_msg == NULL) {
-        LogMessage("ERROR: could not allocate buffer for incoming message\n");
-        abort();
-    }
-    memcpy(str_msg, buffer, size);
-    str_msg[size] = '\0';
-
+    // 'buffer' is not zero terminated, it is handed over together with its size.
     if (messageReceivedCb != 0) {
-        messageReceivedCb(str_msg);
+        messageReceivedCb((const char *)buffer, size);
     } else {
         LogMessage("WARNING: no user callback set up for event 'message received from IoT Hub'\n");
     }
 
-    LogMessage("INFO: Received message '%s' from IoT Hub\n", str_msg);
-    free(str_msg);
+    LogMessage("INFO: Received message '%.*s' from IoT Hub\n", (int)size, (const char *)buffer);
 
     return IOTHUBMESSAGE_ACCEPTED;
 }
@@ -609,44 +697,198 @@ static int directMethodCallback(const char *methodName, const unsigned char *pay
 }
 
 /// <summary>
-///     Callback invoked when a Device Twin update is received from IoT Hub.
+///     Location of the "desired" object in a complete Device Twin document.
 /// </summary>
-static void twinCallback(DEVICE_TWIN_UPDATE_STATE updateState, const unsigned char *payLoad,
-                         size_t payLoadSize, void *userContextCallback)
+typedef struct {
+    bool desiredKeyFound; // The previous event was the "desired" name of the root object.
+    const char *start;    // Opening brace of the "desired" object, NULL until found.
+    const char *end;      // Past its closing brace, NULL until found.
+} DesiredPropertiesSpan;
+
+/// <summary>
+///     Event handler locating the "desired" object, stops the parser once it has been found.
+/// </summary>
+static int desiredPropertiesEventHandler(const JSON_Event *event, void *context)
+{
+    static const char desiredName[] = "desired";
+    DesiredPropertiesSpan *span = (DesiredPropertiesSpan *)context;
+
+    if (span->start != NULL) {
+        if (event->type == JSONEventEndObject && event->depth == 1) {
+            span->end = event->string + event->length;
+            return 0;
+        }
+        return 1;
+    }
+    if (span->desiredKeyFound) {
+        if (event->type != JSONEventStartObject) {
+            return 0;
+        }
+        span->start = event->string;
+        return 1;
+    }
+    span->desiredKeyFound = event->type == JSONEventKey && event->depth == 1 &&
+                            event->length == sizeof(desiredName) - 1 &&
+                            strncmp(event->string, desiredName, event->length) == 0;
+    return 1;
+}
+
+/// <summary>
+///     Records in 'changes' the properties of the cache named in 'names' that differ from
+///     their copy in 'previous'. Removed properties are recorded as null.
+/// </summary>
+/// <returns>'false' when memory is exhausted.</returns>
+static bool CollectDesiredPropertiesChanges(const JSON_Object *names, const JSON_Object *previous,
+                                            JSON_Object *changes)
+{
+    JSON_Object *cache = json_value_get_object(desiredPropertiesCache);
+    for (size_t i = 0; i < json_object_get_count(names); i++) {
+        const char *name = json_object_get_name(names, i);
+        JSON_Value *current = json_object_get_value(cache, name);
+        if (json_value_equals(json_object_get_value(previous, name), current)) {
+            continue;
+        }
+        JSON_Value *change =
+            current != NULL ? json_value_deep_copy(current) : json_value_init_null();
+        if (change == NULL || json_object_set_value(changes, name, change) != JSONSuccess) {
+            json_value_free(change);
+            return false;
+        }
+    }
+    return true;
+}
+
+/// <summary>
+///     Replaces the cached desired properties with those of a complete Device Twin update.
+/// </summary>
+/// <param name="desired">The "desired" object of the update.</param>
+/// <param name="changes">Receives the properties that changed.</param>
+/// <returns>'false' when memory is exhausted.</returns>
+static bool ReplaceDesiredProperties(const JSON_Value *desired, JSON_Object *changes)
 {
-    size_t nullTerminatedJsonSize = payLoadSize + 1;
-    char *nullTerminatedJsonString = (char *)malloc(nullTerminatedJsonSize);
-    if (nullTerminatedJsonString == NULL) {
-        LogMessage("ERROR: Could not allocate buffer for twin update payload.\n");
-        abort();
+    JSON_Value *previous = desiredPropertiesCache;
+    desiredPropertiesCache = json_value_deep_copy(desired);
+    if (desiredPropertiesCache == NULL) {
+        desiredPropertiesCache = previous;
+        return false;
     }
+    // Properties missing from the update were removed, those only in the update were added.
+    bool ok = CollectDesiredPropertiesChanges(json_value_get_object(previous),
+                                              json_value_get_object(previous), changes) &&
+              CollectDesiredPropertiesChanges(json_value_get_object(desiredPropertiesCache),
+                                              json_value_get_object(previous), changes);
+    json_value_free(previous);
+    return ok;
+}
 
-    // Copy the provided buffer to a null terminated buffer.
-    memcpy(nullTerminatedJsonString, payLoad, payLoadSize);
-    // Add the null terminator at the end.
-    nullTerminatedJsonString[nullTerminatedJsonSize - 1] = 0;
+/// <summary>
+///     Merges a partial Device Twin update into the cached desired properties.
+/// </summary>
+/// <param name="patch">The update, a JSON merge patch of the desired properties.</param>
+/// <param name="changes">Receives the properties that changed.</param>
+/// <returns>'false' when memory is exhausted, the cache must then be replaced.</returns>
+static bool MergeDesiredProperties(const JSON_Value *patch, JSON_Object *changes)
+{
+    // Only the properties named by the patch can change, they are copied to be compared.
+    const JSON_Object *patchProperties = json_value_get_object(patch);
+    JSON_Object *cache = json_value_get_object(desiredPropertiesCache);
+    JSON_Value *previous = json_value_init_object();
+    bool ok = previous != NULL;
+    for (size_t i = 0; ok && i < json_object_get_count(patchProperties); i++) {
+        const char *name = json_object_get_name(patchProperties, i);
+        JSON_Value *value = json_object_get_value(cache, name);
+        if (value != NULL) {
+            JSON_Value *copy = json_value_deep_copy(value);
+            ok = copy != NULL &&
+                 json_object_set_value(json_value_get_object(previous), name, copy) == JSONSuccess;
+            if (!ok) {
+                json_value_free(copy);
+            }
+        }
+    }
+    ok = ok && json_merge_patch(desiredPropertiesCache, patch) == JSONSuccess &&
+         CollectDesiredPropertiesChanges(patchProperties, json_value_get_object(previous),
+                                         changes);
+    json_value_free(previous);
+    return ok;
+}
 
+/// <summary>
+///     Callback invoked when a Device Twin update is received from IoT Hub.
+/// </summary>
+static void twinCallback(DEVICE_TWIN_UPDATE_STATE updateState, const unsigned char *payLoad,
+                         size_t payLoadSize, void *userContextCallback)
+{
+    if (twinArena == NULL) {
+        // On failure the document is parsed on the heap instead.
+        twinArena = json_arena_create(0);
+    }
+    if (twinNames == NULL) {
+        // Names are copied into the document if the table cannot be created.
+        twinNames = json_intern_table_create();
+    }
+
+    // A complete twin document also carries the reported properties. It is only scanned for
+    // the "desired" object, which alone is parsed into a document. Partial updates contain the
+    // desired properties at the root, where "desired" is just the name of a property.
+    const char *desiredJson = (const char *)payLoad;
+    size_t desiredJsonSize = payLoadSize;
+    DesiredPropertiesSpan span = {false, NULL, NULL};
+    if (updateState == DEVICE_TWIN_UPDATE_COMPLETE &&
+        json_parse_events(desiredJson, desiredJsonSize, desiredPropertiesEventHandler, &span) ==
+            JSONSuccess &&
+        span.end != NULL) {
+        desiredJson = span.start;
+        desiredJsonSize = (size_t)(span.end - span.start);
+    }
+
+    // 'payLoad' is not null terminated, the parser is bounded by its size instead.
     JSON_Value *rootProperties = NULL;
-    rootProperties = json_parse_string(nullTerminatedJsonString);
-    if (rootProperties == NULL) {
+    JSON_Value *changedProperties = NULL;
+    json_set_intern_table(twinNames);
+    rootProperties = json_parse_buffer_arena(twinArena, desiredJson, desiredJsonSize);
+    json_set_intern_table(NULL); // the cached properties outlive the table's contents
+    if (json_value_get_type(rootProperties) != JSONObject) {
         LogMessage("WARNING: Cannot parse the string as JSON content.\n");
         goto cleanup;
     }
 
-    JSON_Object *rootObject = json_value_get_object(rootProperties);
-    JSON_Object *desiredProperties = json_object_dotget_object(rootObject, "desired");
-    if (desiredProperties == NULL) {
-        desiredProperties = rootObject;
+    changedProperties = json_value_init_object();
+    if (changedProperties == NULL) {
+        LogMessage("ERROR: could not allocate the changed Device Twin properties.\n");
+        goto cleanup;
+    }
+    // A partial update received before any complete one is merged into empty properties.
+    if (desiredPropertiesCache == NULL) {
+        desiredPropertiesCache = json_value_init_object();
+    }
+    bool updated = false;
+    if (updateState == DEVICE_TWIN_UPDATE_PARTIAL && desiredPropertiesCache != NULL) {
+        updated = MergeDesiredProperties(rootProperties, json_value_get_object(changedProperties));
+    } else {
+        updated =
+            ReplaceDesiredProperties(rootProperties, json_value_get_object(changedProperties));
+    }
+    if (!updated) {
+        // The cache may be partly patched, it is rebuilt by the next complete update.
+        LogMessage("ERROR: could not update the cached Device Twin desired properties.\n");
+        json_value_free(desiredPropertiesCache);
+        desiredPropertiesCache = NULL;
+        goto cleanup;
     }
-    // Call the provided Twin Device callback if any.
-    if (twinUpdateCb != NULL) {
-        twinUpdateCb(desiredProperties);
+
+    // Call the provided Twin Device callback if any, with the changed properties only.
+    JSON_Object *changes = json_value_get_object(changedProperties);
+    if (twinUpdateCb != NULL && json_object_get_count(changes) > 0) {
+        twinUpdateCb(changes);
     }
 
 cleanup:
     // Release the allocated memory.
+    json_value_free(changedProperties);
     json_value_free(rootProperties);
-    free(nullTerminatedJsonString);
+    json_arena_reset(twinArena);
+    json_intern_table_clear(twinNames);
 }
 
 /// <summary>
@@ -699,5 +941,15 @@ bool AzureIoT_Initialize(void)
 /// </summary>
 void AzureIoT_Deinitialize(void)
 {
+    json_arena_free(twinArena);
+    twinArena = NULL;
+    json_intern_table_free(twinNames);
+    twinNames = NULL;
+    json_value_free(desiredPropertiesCache);
+    desiredPropertiesCache = NULL;
+    json_value_free(reportedPropertiesCache);
+    reportedPropertiesCache = NULL;
+    json_writer_free(twinReportWriter);
+    twinReportWriter = NULL;
     IoTHub_Deinit();
 }
@@ -32,7 +32,7 @@ void AzureIoT_DestroyClient(void);
 ///     Creates and enqueues a report containing the name and value pair of a Device Twin reported
 ///     property.
 ///     The report is not actually sent immediately, but it is sent on the next invocation of
-///     AzureIoT_DoPeriodicTasks().
+///     AzureIoT_DoPeriodicTasks(). Nothing is sent when the property already has this value.
 /// </summary>
 /// <param name="propertyName">The name of the property to report.</param>
 /// <param name="propertyValue">The value of the property.</param>
@@ -45,6 +45,17 @@ void AzureIoT_TwinReportState(const char *propertyName, size_t propertyValue);
 /// <param name="messagePayload">The payload of the message to send.</param>
 void AzureIoT_SendMessage(const char *messagePayload);
 
+/// <summary>
+///     Creates and enqueues a binary message to be delivered the IoT Hub, with the content type
+///     system property set so that the payload can be decoded on the cloud side, e.g. CBOR from
+///     json_writer_serialize_cbor() with "application/cbor".
+/// </summary>
+/// <param name="messagePayload">The payload of the message to send.</param>
+/// <param name="messagePayloadSize">The size of the payload.</param>
+/// <param name="contentType">The media type of the payload.</param>
+void AzureIoT_SendMessageWithContentType(const unsigned char *messagePayload,
+                                         size_t messagePayloadSize, const char *contentType);
+
 /// <summary>
 ///     Keeps IoT Hub Client alive by exchanging data with the Azure IoT Hub.
 /// </summary>
@@ -58,7 +69,10 @@ void AzureIoT_DoPeriodicTasks(void);
 /// <summary>
 ///     Type of the function callback invoked whenever a message is received from IoT Hub.
 /// </summary>
-typedef void (*MessageReceivedFnType)(const char *payload);
+/// <param name="payload">The payload of the message. It is not NUL-terminated and only valid for
+/// the duration of the call.</param>
+/// <param name="payloadSize">The size of the payload.</param>
+typedef void (*MessageReceivedFnType)(const char *payload, size_t payloadSize);
 
 /// <summary>
 ///     Sets a callback function invoked whenever a message is received from IoT Hub.
@@ -70,7 +84,9 @@ void AzureIoT_SetMessageReceivedCallback(MessageReceivedFnType callback);
 ///     Type of the function callback invoked whenever a Device Twin update from the IoT Hub is
 ///     received.
 /// </summary>
-/// <param name="handle">The JSON object containing the Device Twin desired properties.</handle>
+/// <param name="handle">The JSON object containing the Device Twin desired properties that
+/// changed since the previous update; removed properties are null. It is read-only and only valid
+/// for the duration of the call. The callback is not invoked when nothing changed.</handle>
 typedef void (*TwinUpdateFnType)(JSON_Object *desiredProperties);
 
 /// <summary>
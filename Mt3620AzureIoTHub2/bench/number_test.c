@@ -0,0 +1,132 @@
+/*
+    Differential test of parson's number parsing against strtod on the host.
+
+    Integers and short decimals are parsed by parson itself, other numbers through strtod. Both
+    must give the same double, bit for bit, on random integers and decimals of every length
+    around the limits of the fast path and on a list of boundary values. Malformed numbers must
+    be rejected; they are checked as array items, since text after the root value is ignored.
+    Forms strtod is lenient with, such as "1.", are accepted as they were before the fast path.
+
+    Usage: number_test [random_count]
+*/
+#include "parson.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_RANDOM_COUNT 3000000
+#define NUMBER_BUF_SIZE 64
+
+static unsigned long long random_state = 88172645463325252ULL;
+static unsigned long checked = 0;
+static unsigned long mismatches = 0;
+
+static unsigned long long next_random(void)
+{
+    random_state ^= random_state << 13; /* xorshift64 */
+    random_state ^= random_state >> 7;
+    random_state ^= random_state << 17;
+    return random_state;
+}
+
+/* Appends count random digits, the first one not zero when nonzero_first is set */
+static size_t append_digits(char *buf, size_t count, int nonzero_first)
+{
+    size_t i = 0;
+    for (i = 0; i < count; i++) {
+        buf[i] = (char)('0' + (i == 0 && nonzero_first ? 1 + next_random() % 9
+                                                       : next_random() % 10));
+    }
+    return count;
+}
+
+static void check(const char *number)
+{
+    JSON_Value *value = json_parse_string(number);
+    double expected = strtod(number, NULL), actual = 0;
+    checked++;
+    if (value == NULL || json_value_get_type(value) != JSONNumber) {
+        fprintf(stderr, "not parsed: %s\n", number);
+        mismatches++;
+    } else {
+        actual = json_value_get_number(value);
+        if (memcmp(&actual, &expected, sizeof(double)) != 0) {
+            fprintf(stderr, "mismatch: %s parsed as %.17g, strtod gives %.17g\n", number, actual,
+                    expected);
+            mismatches++;
+        }
+    }
+    json_value_free(value);
+}
+
+static void check_rejected(const char *number)
+{
+    char buf[NUMBER_BUF_SIZE];
+    JSON_Value *value = NULL;
+    sprintf(buf, "[%s]", number);
+    value = json_parse_string(buf);
+    checked++;
+    if (value != NULL) {
+        fprintf(stderr, "accepted: %s\n", buf);
+        mismatches++;
+    }
+    json_value_free(value);
+}
+
+/* An integer or decimal of up to 17 integer digits and 25 decimals, on both sides of the 15
+   significant digits and 22 decimals that the fast path takes */
+static void check_random(void)
+{
+    char buf[NUMBER_BUF_SIZE];
+    size_t length = 0, integer_digits = 0, decimals = 0, zeros = 0;
+    if (next_random() % 2) {
+        buf[length++] = '-';
+    }
+    integer_digits = (size_t)(next_random() % 18);
+    if (integer_digits == 0) {
+        buf[length++] = '0';
+    } else {
+        length += append_digits(buf + length, integer_digits, 1);
+    }
+    decimals = (size_t)(next_random() % 4 == 0 ? 0 : next_random() % 26);
+    if (decimals > 0) {
+        buf[length++] = '.';
+        zeros = integer_digits == 0 ? (size_t)(next_random() % (decimals + 1)) : 0;
+        memset(buf + length, '0', zeros); /* leading zeros are not significant */
+        length += zeros;
+        length += append_digits(buf + length, decimals - zeros, 0);
+    }
+    buf[length] = '\0';
+    check(buf);
+}
+
+int main(int argc, char *argv[])
+{
+    static const char *const boundaries[] = {
+        "0", "-0", "0.0", "-0.0", "1", "-1", "0.1", "0.2", "0.3", "2.5", "123.456",
+        "999999999999999", "-999999999999999", "1000000000000000", "9007199254740991",
+        "9007199254740992", "9007199254740993", "18446744073709551615", "99999999999999999999999",
+        "0.999999999999999", "99999999999999.9", "12345678901234.5", "123456789012345.6",
+        "0.0000000000000000000001", "0.00000000000000000000001", "0.0000000000000000000009",
+        "4.9406564584124654", "2.2250738585072014", "1.7976931348623157", "0.30000000000000004",
+        "1e0", "1E-7", "2.5e+10", "-1.5e-300", "1.7976931348623157e308", "2.2250738585072014e-308",
+        "1e23", "0.1234567890123456789012", "1.000000000000000000000", "100000000000000.0"};
+    static const char *const malformed[] = {"01", "-01", "-", ".5", "+1", "0x10", "1e", "1e+",
+                                            "--1", "00.1", "1.5.2", "1-2", "0.5e"};
+    unsigned long random_count = DEFAULT_RANDOM_COUNT, i = 0;
+    if (argc > 1) {
+        random_count = strtoul(argv[1], NULL, 10);
+    }
+    for (i = 0; i < sizeof(boundaries) / sizeof(boundaries[0]); i++) {
+        check(boundaries[i]);
+    }
+    for (i = 0; i < sizeof(malformed) / sizeof(malformed[0]); i++) {
+        check_rejected(malformed[i]);
+    }
+    for (i = 0; i < random_count; i++) {
+        check_random();
+    }
+    printf("%lu numbers checked, %lu mismatches\n", checked, mismatches);
+    return mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
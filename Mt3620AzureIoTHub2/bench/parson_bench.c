@@ -0,0 +1,616 @@
+/*
+    Host benchmark of parson.c over the documents this application exchanges with IoT Hub:
+    cloud to device commands, complete and partial Device Twin updates and telemetry readings,
+    plus large synthetic documents.
+
+    Every operation runs until it takes at least the given time (200 ms by default) and one CSV
+    line is printed for it: the time per operation, the bytes and the number of allocations it
+    made through parson, the most bytes it held at once and the bytes it output, if any. Values
+    parsed or copied are freed within the operation, so their cost is part of it. Operations
+    named after a C library function time that function alone on the same data, as a baseline.
+    The write operations serialize into one JSON_Writer that is reused, as main.c does, and
+    parse_cbor decodes what write_cbor outputs.
+
+    Usage: parson_bench [min_ms] > results.csv
+*/
+#define _POSIX_C_SOURCE 199309L
+
+#include "parson.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_MIN_MS 200
+#define BATCH_READINGS 1000
+#define WIDE_MEMBERS 1000
+#define DEEP_LEVELS 512
+#define NUMBER_COUNT 100000
+#define STRING_OBJECTS 1000
+#define STRING_LENGTH 1000
+#define INDENT_SPACES 32
+#define CORPUS_MAX_SIZE 32
+
+/* Operations a case runs */
+#define OP_PARSE 0x01
+#define OP_SERIALIZE 0x02
+#define OP_SERIALIZE_PRETTY 0x04
+#define OP_DEEP_COPY 0x08
+#define OP_EQUALS 0x10
+#define OP_DOTGET 0x20
+#define OP_SPRINTF 0x40
+#define OP_STRTOD 0x80
+#define OP_WRITE 0x100
+#define OP_WRITE_CBOR 0x200
+#define OP_PARSE_CBOR 0x400
+#define OPS_DOCUMENT \
+    (OP_PARSE | OP_SERIALIZE | OP_SERIALIZE_PRETTY | OP_DEEP_COPY | OP_EQUALS | OP_DOTGET | \
+     OP_WRITE | OP_WRITE_CBOR | OP_PARSE_CBOR)
+
+/* Keeps the size of every allocation in front of it, aligned as malloc aligns */
+typedef union bench_header_t {
+    size_t size;
+    long double align_long_double;
+    void *align_pointer;
+} Bench_Header;
+
+typedef struct bench_case_t {
+    const char *name;
+    unsigned int operations;
+    char *text;
+    char *path;         /* dotted name of a member, read by dotget */
+    JSON_Value *value;  /* parsed from text, for the operations that do not parse */
+    JSON_Value *copy;   /* deep copy of value, for equals */
+    unsigned char *cbor; /* value encoded as CBOR, for parse_cbor */
+    size_t cbor_length;
+} Bench_Case;
+
+/* Runs the operation once, returns 0 on failure */
+typedef int (*Bench_Operation)(const Bench_Case *bench_case);
+
+static size_t alloc_count = 0;
+static size_t alloc_bytes = 0;
+static size_t live_bytes = 0;
+static size_t peak_bytes = 0;
+static size_t output_bytes = 0;       /* of the last run of an operation */
+static JSON_Writer *writer = NULL;    /* reused by the write operations */
+static volatile size_t bench_sink = 0; /* keeps results alive */
+
+static void *counting_malloc(size_t size)
+{
+    Bench_Header *header = (Bench_Header *)malloc(sizeof(Bench_Header) + size);
+    if (header == NULL) {
+        return NULL;
+    }
+    header->size = size;
+    alloc_count++;
+    alloc_bytes += size;
+    live_bytes += size;
+    if (live_bytes > peak_bytes) {
+        peak_bytes = live_bytes;
+    }
+    return header + 1;
+}
+
+static void counting_free(void *ptr)
+{
+    Bench_Header *header = NULL;
+    if (ptr == NULL) {
+        return;
+    }
+    header = (Bench_Header *)ptr - 1;
+    live_bytes -= header->size;
+    free(header);
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/* Operations */
+static int op_parse(const Bench_Case *bench_case)
+{
+    JSON_Value *value = json_parse_string(bench_case->text);
+    if (value == NULL) {
+        return 0;
+    }
+    bench_sink += (size_t)json_value_get_type(value);
+    json_value_free(value);
+    return 1;
+}
+
+static int op_serialize(const Bench_Case *bench_case)
+{
+    char *string = json_serialize_to_string(bench_case->value);
+    if (string == NULL) {
+        return 0;
+    }
+    output_bytes = strlen(string);
+    bench_sink += (size_t)string[0];
+    json_free_serialized_string(string);
+    return 1;
+}
+
+static int op_serialize_pretty(const Bench_Case *bench_case)
+{
+    char *string = json_serialize_to_string_pretty(bench_case->value);
+    if (string == NULL) {
+        return 0;
+    }
+    output_bytes = strlen(string);
+    bench_sink += (size_t)string[0];
+    json_free_serialized_string(string);
+    return 1;
+}
+
+static int op_deep_copy(const Bench_Case *bench_case)
+{
+    JSON_Value *copy = json_value_deep_copy(bench_case->value);
+    if (copy == NULL) {
+        return 0;
+    }
+    bench_sink += (size_t)json_value_get_type(copy);
+    json_value_free(copy);
+    return 1;
+}
+
+static int op_equals(const Bench_Case *bench_case)
+{
+    int equal = json_value_equals(bench_case->value, bench_case->copy);
+    bench_sink += (size_t)equal;
+    return equal;
+}
+
+static int op_dotget(const Bench_Case *bench_case)
+{
+    JSON_Value *member =
+        json_object_dotget_value(json_value_get_object(bench_case->value), bench_case->path);
+    bench_sink += (size_t)json_value_get_type(member);
+    return member != NULL;
+}
+
+static int op_write(const Bench_Case *bench_case)
+{
+    if (json_writer_serialize(writer, bench_case->value) != JSONSuccess) {
+        return 0;
+    }
+    output_bytes = json_writer_get_length(writer);
+    bench_sink += output_bytes;
+    return 1;
+}
+
+static int op_write_cbor(const Bench_Case *bench_case)
+{
+    if (json_writer_serialize_cbor(writer, bench_case->value) != JSONSuccess) {
+        return 0;
+    }
+    output_bytes = json_writer_get_length(writer);
+    bench_sink += output_bytes;
+    return 1;
+}
+
+static int op_parse_cbor(const Bench_Case *bench_case)
+{
+    JSON_Value *value = json_parse_cbor(bench_case->cbor, bench_case->cbor_length);
+    if (value == NULL) {
+        return 0;
+    }
+    bench_sink += (size_t)json_value_get_type(value);
+    json_value_free(value);
+    return 1;
+}
+
+/* Formats the numbers of an array as parson did before its own formatting */
+static int op_sprintf(const Bench_Case *bench_case)
+{
+    JSON_Array *array = json_value_get_array(bench_case->value);
+    char buf[64];
+    size_t i = 0, length = 0;
+    for (i = 0; i < json_array_get_count(array); i++) {
+        length += (size_t)sprintf(buf, "%1.17g", json_array_get_number(array, i));
+    }
+    output_bytes = length;
+    bench_sink += length;
+    return array != NULL;
+}
+
+/* Converts the numbers of an array with strtod, as parson did before its own parsing */
+static int op_strtod(const Bench_Case *bench_case)
+{
+    const char *ptr = bench_case->text;
+    char *end = NULL;
+    double sum = 0;
+    while (*ptr != '\0') {
+        if (*ptr == '[' || *ptr == ',' || *ptr == ']') {
+            ptr++;
+            continue;
+        }
+        sum += strtod(ptr, &end);
+        if (end == ptr) {
+            return 0;
+        }
+        ptr = end;
+    }
+    bench_sink += (size_t)sum;
+    return 1;
+}
+
+/* Corpus */
+static char *duplicate(const char *string)
+{
+    size_t length = strlen(string);
+    char *copy = (char *)malloc(length + 1);
+    if (copy != NULL) {
+        memcpy(copy, string, length + 1);
+    }
+    return copy;
+}
+
+/* {"deviceId":..,"readings":[..]} with readings as sent by SendReadingToIotHub */
+static char *synthetic_batch(void)
+{
+    size_t capacity = 64 + BATCH_READINGS * 160, length = 0;
+    char *text = (char *)malloc(capacity);
+    int i = 0;
+    if (text == NULL) {
+        return NULL;
+    }
+    length += (size_t)sprintf(text, "{\"deviceId\":\"mt3620-0001\",\"readings\":[");
+    for (i = 0; i < BATCH_READINGS; i++) {
+        length += (size_t)sprintf(text + length,
+                                  "%s{\"type\":\"Reading\",\"origin\":\"Sphere\","
+                                  "\"timestamp\":%.0f,\"data\":{\"type\":\"%s\","
+                                  "\"value\":%d.%02d}}",
+                                  i > 0 ? "," : "", 1760659200000.0 + i * 5000.0,
+                                  i % 2 ? "Humidity" : "Temperature", 20 + i % 30, (i * 37) % 100);
+    }
+    sprintf(text + length, "]}");
+    return text;
+}
+
+/* An object with members of every type, looked up by the name of the last one */
+static char *synthetic_wide(void)
+{
+    size_t capacity = 16 + WIDE_MEMBERS * 48, length = 0;
+    char *text = (char *)malloc(capacity);
+    int i = 0;
+    if (text == NULL) {
+        return NULL;
+    }
+    text[length++] = '{';
+    for (i = 0; i < WIDE_MEMBERS; i++) {
+        length += (size_t)sprintf(text + length, "%s\"property%d\":", i > 0 ? "," : "", i);
+        switch (i % 4) {
+        case 0:
+            length += (size_t)sprintf(text + length, "%d.5", i);
+            break;
+        case 1:
+            length += (size_t)sprintf(text + length, "\"value %d\"", i);
+            break;
+        case 2:
+            length += (size_t)sprintf(text + length, "%s", i % 3 ? "true" : "false");
+            break;
+        default:
+            length += (size_t)sprintf(text + length, "[%d,null]", i);
+            break;
+        }
+    }
+    sprintf(text + length, "}");
+    return text;
+}
+
+/* Doubles spread over many magnitudes, as sprintf("%.17g") prints them */
+static char *synthetic_numbers(void)
+{
+    char *text = (char *)malloc(NUMBER_COUNT * 26 + 2);
+    unsigned long long state = 1;
+    size_t length = 0;
+    int i = 0;
+    if (text == NULL) {
+        return NULL;
+    }
+    text[length++] = '[';
+    for (i = 0; i < NUMBER_COUNT; i++) {
+        state ^= state << 13; /* xorshift64 */
+        state ^= state >> 7;
+        state ^= state << 17;
+        length += (size_t)sprintf(text + length, "%s%.17g", i > 0 ? "," : "",
+                                  (double)(state % 1000000) / (double)(1 + (state >> 40) % 1000));
+    }
+    text[length++] = ']';
+    text[length] = '\0';
+    return text;
+}
+
+/* Integers and decimals with two digits, which parson parses without strtod */
+static char *synthetic_small_numbers(void)
+{
+    char *text = (char *)malloc(NUMBER_COUNT * 8 + 2);
+    size_t length = 0;
+    int i = 0;
+    if (text == NULL) {
+        return NULL;
+    }
+    text[length++] = '[';
+    for (i = 0; i < NUMBER_COUNT; i++) {
+        if (i % 3 != 0) {
+            length += (size_t)sprintf(text + length, "%s%d", i > 0 ? "," : "", i % 1000);
+        } else {
+            length += (size_t)sprintf(text + length, "%s%d.%02d", i > 0 ? "," : "",
+                                      (i % 100000) / 100, i % 100);
+        }
+    }
+    text[length++] = ']';
+    text[length] = '\0';
+    return text;
+}
+
+/* {"gateway/device-00000":0,..} with count members, to time parsing per member */
+static char *synthetic_keys(int count)
+{
+    char *text = (char *)malloc((size_t)count * 32 + 2);
+    size_t length = 0;
+    int i = 0;
+    if (text == NULL) {
+        return NULL;
+    }
+    text[length++] = '{';
+    for (i = 0; i < count; i++) {
+        length += (size_t)sprintf(text + length, "%s\"gateway/device-%05d\":%d",
+                                  i > 0 ? "," : "", i, i);
+    }
+    text[length++] = '}';
+    text[length] = '\0';
+    return text;
+}
+
+/* [{"text":"abc..","a":{"b":{"c":{"d":1}}}},..] with long strings, compact or with every line
+   indented by INDENT_SPACES more than json_serialize_to_string_pretty does */
+static char *synthetic_strings(int indented)
+{
+    static const char *const names[] = {"a", "b", "c", "d"};
+    size_t capacity = STRING_OBJECTS * (STRING_LENGTH + 16 * (INDENT_SPACES + 32)) + 64;
+    size_t length = 0, j = 0, k = 0, indent = 0;
+    char *text = (char *)malloc(capacity);
+    int i = 0;
+    if (text == NULL) {
+        return NULL;
+    }
+    text[length++] = '[';
+    for (i = 0; i < STRING_OBJECTS; i++) {
+        if (i > 0) {
+            text[length++] = ',';
+        }
+        for (j = 0; j < 6; j++) {
+            /* before the object, its text and each of its levels */
+            if (indented) {
+                indent = INDENT_SPACES + 4 * (j < 2 ? j + 1 : j);
+                text[length++] = '\n';
+                memset(text + length, ' ', indent);
+                length += indent;
+            }
+            if (j == 0) {
+                text[length++] = '{';
+            } else if (j == 1) {
+                length += (size_t)sprintf(text + length, "\"text\":\"");
+                for (k = 0; k < STRING_LENGTH; k++) {
+                    text[length++] = (char)('a' + (i + k) % 26);
+                }
+                length += (size_t)sprintf(text + length, "\",");
+            } else {
+                length += (size_t)sprintf(text + length, "\"%s\":%s", names[j - 2],
+                                          j < 5 ? "{" : "");
+            }
+        }
+        length += (size_t)sprintf(text + length, "%d}}}}", i);
+    }
+    text[length++] = ']';
+    text[length] = '\0';
+    return text;
+}
+
+/* {"level":{"level":...{"level":1}...}}, and the dotted name of the innermost member */
+static char *synthetic_deep(char **path)
+{
+    static const char member[] = "{\"level\":";
+    size_t length = 0;
+    char *text = (char *)malloc(DEEP_LEVELS * (sizeof(member) + 1) + 2);
+    int i = 0;
+    *path = (char *)malloc(DEEP_LEVELS * sizeof("level."));
+    if (text == NULL || *path == NULL) {
+        free(text);
+        return NULL;
+    }
+    (*path)[0] = '\0';
+    for (i = 0; i < DEEP_LEVELS; i++) {
+        memcpy(text + length, member, sizeof(member) - 1);
+        length += sizeof(member) - 1;
+        strcat(*path, i > 0 ? ".level" : "level");
+    }
+    text[length++] = '1';
+    for (i = 0; i < DEEP_LEVELS; i++) {
+        text[length++] = '}';
+    }
+    text[length] = '\0';
+    return text;
+}
+
+static void add_case(Bench_Case *corpus, int *count, const char *name, unsigned int operations,
+                     char *text, char *path)
+{
+    corpus[*count].name = name;
+    corpus[*count].operations = operations;
+    corpus[*count].text = text;
+    corpus[*count].path = path;
+    (*count)++;
+}
+
+static int init_corpus(Bench_Case *corpus)
+{
+    static const char *const documents[][3] = {
+        {"c2d_command", "{\"Data\":{\"type\":\"SetLight\",\"value\":1}}", "Data.type"},
+        {"twin_complete",
+         "{\"desired\":{\"LedBlinkRateProperty\":2,\"$version\":12},"
+         "\"reported\":{\"LedBlinkRateProperty\":2,\"$metadata\":{\"$lastUpdated\":"
+         "\"2026-10-16T08:15:42.1234567Z\",\"LedBlinkRateProperty\":{\"$lastUpdated\":"
+         "\"2026-10-16T08:15:42.1234567Z\"}},\"$version\":9}}",
+         "desired.LedBlinkRateProperty"},
+        {"twin_desired",
+         "{\"desired\":{\"LedBlinkRateProperty\":2,\"$version\":12,\"Reading\":\"Sphere\","
+         "\"unit\":\"C\",\"name\":\"Sensor-01\",\"list\":[\"a\",\"bb\",\"ccc\",\"temperature\","
+         "\"humidity\"]},\"reported\":{\"$version\":3,\"status\":\"ok\"}}",
+         "desired.name"},
+        {"telemetry_presence",
+         "{\"type\":\"Reading\",\"origin\":\"Sphere\",\"timestamp\":\"2019-05-02T10:11:12.123Z\","
+         "\"data\":{\"type\":\"Presence\",\"value\":1}}",
+         "data.value"},
+        {"telemetry_temperature",
+         "{\"type\":\"Reading\",\"origin\":\"Sphere\",\"timestamp\":\"2019-05-02T10:11:12.123Z\","
+         "\"data\":{\"type\":\"Temperature\",\"value\":23.456789}}",
+         "data.value"},
+        {"twin_partial", "{\"LedBlinkRateProperty\":1,\"$version\":13}", "LedBlinkRateProperty"},
+        {"telemetry",
+         "{\"type\":\"Reading\",\"origin\":\"Sphere\",\"timestamp\":1760659200000,"
+         "\"data\":{\"type\":\"Temperature\",\"value\":23.45}}",
+         "data.value"}};
+    char *text = NULL, *path = NULL;
+    int i = 0, count = 0;
+    for (i = 0; i < (int)(sizeof(documents) / sizeof(documents[0])); i++) {
+        add_case(corpus, &count, documents[i][0], OPS_DOCUMENT, duplicate(documents[i][1]),
+                 duplicate(documents[i][2]));
+    }
+    add_case(corpus, &count, "synthetic_batch", OPS_DOCUMENT, synthetic_batch(),
+             duplicate("deviceId"));
+    add_case(corpus, &count, "synthetic_wide", OPS_DOCUMENT, synthetic_wide(),
+             duplicate("property999"));
+    text = synthetic_deep(&path);
+    add_case(corpus, &count, "synthetic_deep", OPS_DOCUMENT, text, path);
+    add_case(corpus, &count, "synthetic_keys_100", OP_PARSE, synthetic_keys(100),
+             duplicate(""));
+    add_case(corpus, &count, "synthetic_keys_1000", OP_PARSE, synthetic_keys(1000),
+             duplicate(""));
+    add_case(corpus, &count, "synthetic_keys_10000", OP_PARSE, synthetic_keys(10000),
+             duplicate(""));
+    add_case(corpus, &count, "synthetic_strings", OP_PARSE, synthetic_strings(0),
+             duplicate(""));
+    add_case(corpus, &count, "synthetic_strings_indented", OP_PARSE, synthetic_strings(1),
+             duplicate(""));
+    add_case(corpus, &count, "synthetic_numbers", OP_PARSE | OP_SERIALIZE | OP_SPRINTF,
+             synthetic_numbers(), duplicate(""));
+    add_case(corpus, &count, "synthetic_small_numbers", OP_PARSE | OP_STRTOD,
+             synthetic_small_numbers(), duplicate(""));
+    for (i = 0; i < count; i++) {
+        if (corpus[i].text == NULL || corpus[i].path == NULL) {
+            return -1;
+        }
+        corpus[i].value = json_parse_string(corpus[i].text);
+        corpus[i].copy = json_value_deep_copy(corpus[i].value);
+        if (corpus[i].value == NULL || corpus[i].copy == NULL) {
+            fprintf(stderr, "cannot parse %s\n", corpus[i].name);
+            return -1;
+        }
+        if ((corpus[i].operations & OP_PARSE_CBOR) != 0) {
+            corpus[i].cbor_length = json_serialization_size_cbor(corpus[i].value);
+            corpus[i].cbor = (unsigned char *)malloc(corpus[i].cbor_length);
+            if (corpus[i].cbor == NULL || corpus[i].cbor_length == 0 ||
+                json_serialize_to_buffer_cbor(corpus[i].value, corpus[i].cbor,
+                                              corpus[i].cbor_length) != JSONSuccess) {
+                fprintf(stderr, "cannot encode %s\n", corpus[i].name);
+                return -1;
+            }
+        }
+    }
+    return count;
+}
+
+/* Runs operation in batches that double until one takes min_ns, and reports the last one */
+static int run(const Bench_Case *bench_case, const char *operation_name,
+               Bench_Operation operation, double min_ns)
+{
+    size_t iterations = 1, i = 0, baseline = 0;
+    double start = 0, elapsed = 0;
+    for (;;) {
+        alloc_count = 0;
+        alloc_bytes = 0;
+        output_bytes = 0;
+        baseline = live_bytes;
+        peak_bytes = live_bytes;
+        start = now_ns();
+        for (i = 0; i < iterations; i++) {
+            if (!operation(bench_case)) {
+                fprintf(stderr, "%s failed on %s\n", operation_name, bench_case->name);
+                return 0;
+            }
+        }
+        elapsed = now_ns() - start;
+        if (elapsed >= min_ns) {
+            break;
+        }
+        iterations *= 2;
+    }
+    printf("%s,%s,%lu,%lu,%.1f,%.1f,%.2f,%lu,%lu\n", bench_case->name, operation_name,
+           (unsigned long)strlen(bench_case->text), (unsigned long)iterations,
+           elapsed / (double)iterations, (double)alloc_bytes / (double)iterations,
+           (double)alloc_count / (double)iterations, (unsigned long)(peak_bytes - baseline),
+           (unsigned long)output_bytes);
+    return 1;
+}
+
+int main(int argc, char *argv[])
+{
+    static const struct {
+        const char *name;
+        unsigned int flag;
+        Bench_Operation operation;
+    } operations[] = {{"parse", OP_PARSE, op_parse},
+                      {"serialize", OP_SERIALIZE, op_serialize},
+                      {"serialize_pretty", OP_SERIALIZE_PRETTY, op_serialize_pretty},
+                      {"deep_copy", OP_DEEP_COPY, op_deep_copy},
+                      {"equals", OP_EQUALS, op_equals},
+                      {"dotget", OP_DOTGET, op_dotget},
+                      {"sprintf", OP_SPRINTF, op_sprintf},
+                      {"strtod", OP_STRTOD, op_strtod},
+                      {"write", OP_WRITE, op_write},
+                      {"write_cbor", OP_WRITE_CBOR, op_write_cbor},
+                      {"parse_cbor", OP_PARSE_CBOR, op_parse_cbor}};
+    Bench_Case corpus[CORPUS_MAX_SIZE];
+    double min_ns = DEFAULT_MIN_MS * 1e6;
+    int count = 0, i = 0, status = EXIT_SUCCESS;
+    size_t j = 0;
+    if (argc > 1) {
+        min_ns = atof(argv[1]) * 1e6;
+    }
+    json_set_allocation_functions(counting_malloc, counting_free);
+    memset(corpus, 0, sizeof(corpus));
+    writer = json_writer_create(0);
+    count = init_corpus(corpus);
+    if (count < 0 || writer == NULL) {
+        status = EXIT_FAILURE;
+        count = (int)(sizeof(corpus) / sizeof(corpus[0]));
+    } else {
+        printf("corpus,operation,input_bytes,iterations,ns_per_op,bytes_per_op,allocs_per_op,"
+               "peak_bytes,output_bytes\n");
+        for (i = 0; i < count && status == EXIT_SUCCESS; i++) {
+            for (j = 0; j < sizeof(operations) / sizeof(operations[0]); j++) {
+                if ((corpus[i].operations & operations[j].flag) != 0 &&
+                    !run(&corpus[i], operations[j].name, operations[j].operation, min_ns)) {
+                    status = EXIT_FAILURE;
+                    break;
+                }
+            }
+        }
+    }
+    for (i = 0; i < count; i++) {
+        json_value_free(corpus[i].value);
+        json_value_free(corpus[i].copy);
+        free(corpus[i].text);
+        free(corpus[i].path);
+        free(corpus[i].cbor);
+    }
+    json_writer_free(writer);
+    return status;
+}
@@ -1,5 +1,6 @@
 ﻿#include <errno.h>
 #include <signal.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <time.h>
 #include <regex.h>
@@ -90,6 +91,17 @@ static int lampState = 0;
 static int buzzerState = 0;
 // UART number of bytes receiveds
 static size_t totalBytesReceived = 0;
+// Command carried by the cloud to device messages, decoded from {"Data":{"type":..,"value":..}}
+typedef struct {
+    char type[16];
+    double value;
+} C2DCommand;
+static const JSON_Field c2dCommandFields[] = {
+    {"Data.type", JSONFieldString, offsetof(C2DCommand, type), sizeof(((C2DCommand *)0)->type)},
+    {"Data.value", JSONFieldNumber, offsetof(C2DCommand, value), sizeof(double)}};
+static const size_t c2dCommandFieldsCount = sizeof(c2dCommandFields) / sizeof(*c2dCommandFields);
+// Values from the Raspberry Pi arrive over UART in pieces, the stream keeps the partial one
+static JSON_Stream *uartStream = NULL;
 
 // LED state
 static RgbLed led1 = RGBLED_INIT_VALUE;
@@ -297,7 +309,37 @@ static void SendUartMessage(int uartFd, const char *dataToSend)
 }
 
 /// <summary>
-///     Handle UART event: if there is incoming data, print it and send it to the cloud
+///     Runs a command received from the Raspberry Pi
+/// </summary>
+/// <param name="command">The name of the command</param>
+static void HandleUartCommand(const char *command)
+{
+	if (strcmp(command, "lightOn") == 0) {
+		GroveLEDButton_LedOn(btn);
+		lampState = 1;
+	}
+	else if (strcmp(command, "lightOff") == 0) {
+		GroveLEDButton_LedOff(btn);
+		lampState = 0;
+	}
+	else if (strcmp(command, "tempT") == 0) {
+		JSON_Value *temp = json_value_init_number_fixed(GroveTempHumiSHT31_GetTemperature(sht31), 2);
+		char f[32];
+		if (json_serialize_to_buffer(temp, f, sizeof(f)) == JSONSuccess) {
+			SendUartMessage(uartFd, f);
+		}
+		json_value_free(temp);
+	}
+}
+
+/// <summary>
+///     Handle UART event: feed incoming data to the JSON stream and run the command named by
+///     every complete string value.
+///     The Raspberry Pi sends every command as a JSON string, such as "lightOn", optionally
+///     separated by whitespace. Reads return arbitrary pieces of 1 to 256 bytes of that input, so
+///     a command can span several reads and a read can hold several commands. Input that is not
+///     JSON is dropped up to the end of the read it was found in, and parsing starts over with the
+///     next read.
 /// </summary>
 static void UartEventHandler(event_data_t *eventData)
 {
@@ -316,30 +358,30 @@ static void UartEventHandler(event_data_t *eventData)
 	if (bytesRead > 0) {
 		// Null terminate the buffer to make it a valid string, and print it
 		receiveBuffer[bytesRead] = 0;
-		//Log_Debug("UART received %d bytes: '%s'.\n", bytesRead, receiveBuffer);
-
-
-		// If message receive is lightOn turn on, else turn off
 		totalBytesReceived += (size_t)bytesRead;
 		Log_Debug(receiveBuffer);
 
-		if (strcmp((char*)receiveBuffer, "lightOn") == 0) {
-			GroveLEDButton_LedOn(btn);
-			lampState = 1;
-			
+		const char *data = (const char *)receiveBuffer;
+		size_t dataSize = (size_t)bytesRead;
+		while (dataSize > 0) {
+			size_t consumed = 0;
+			JSON_Stream_Status status = json_stream_feed(uartStream, data, dataSize, &consumed);
+			data += consumed;
+			dataSize -= consumed;
+			if (status == JSONStreamComplete) {
+				JSON_Value *value = json_stream_take_value(uartStream);
+				const char *command = json_value_get_string(value);
+				if (command != NULL) {
+					HandleUartCommand(command);
+				}
+				json_value_free(value);
+			}
+			else if (status == JSONStreamError) {
+				Log_Debug("WARNING: Dropped %zu bytes of UART input that is not JSON.\n", dataSize);
+				json_stream_reset(uartStream);
+				break;
+			}
 		}
-		else if (strcmp((char*)receiveBuffer, "lightOff") == 0) {
-			GroveLEDButton_LedOff(btn);
-			lampState = 0;
-		}
-		else if (strcmp((char*)receiveBuffer, "tempT") == 0) {
-			float temp = GroveTempHumiSHT31_GetTemperature(sht31);
-			char f[10];
-			sprintf(f, "%f", temp);
-			SendUartMessage(uartFd,f);
-		}
-
-
 	}
 }
 
@@ -425,24 +467,61 @@ static void SendMessageToIotHub(char* message)
     }
 }
 
+/// <summary>
+///     Sends a reading to the IoT Hub, with its value rounded to the given number of decimals.
+/// </summary>
+/// <param name="type">The type of the reading, e.g. "Temperature"</param>
+/// <param name="value">The value read from the sensor</param>
+/// <param name="decimals">The number of decimals sent</param>
+static void SendReadingToIotHub(const char *type, double value, int decimals)
+{
+    char message[200];
+    JSON_Value *reading = json_value_init_object();
+    JSON_Object *readingObject = json_value_get_object(reading);
+    time_t now;
+    time(&now);
+    if (json_object_set_string(readingObject, "type", "Reading") != JSONSuccess ||
+        json_object_set_string(readingObject, "origin", "Sphere") != JSONSuccess ||
+        json_object_set_number(readingObject, "timestamp", (double)now * 1000) != JSONSuccess ||
+        json_object_dotset_string(readingObject, "data.type", type) != JSONSuccess ||
+        json_object_dotset_number_fixed(readingObject, "data.value", value, decimals) !=
+            JSONSuccess ||
+        json_serialize_to_buffer(reading, message, sizeof(message)) != JSONSuccess) {
+        Log_Debug("ERROR: Could not build the %s reading.\n", type);
+    } else {
+        SendMessageToIotHub(message);
+    }
+    json_value_free(reading);
+}
+
 /// <summary>
 ///     MessageReceived callback function, called when a message is received from the Azure IoT Hub.
 /// </summary>
 /// <param name="payload">The payload of the received message.</param>
-static void MessageReceived(const char *payload)
+/// <param name="payloadSize">The size of the payload, which is not null terminated.</param>
+static void MessageReceived(const char *payload, size_t payloadSize)
 {
 
 	int statuts;
-	JSON_Value * json = json_parse_string(payload);
-	char *commande = json_object_get_string(json_object_get_object(json_object(json), "Data"), "type");
-	 statuts = json_object_get_number(json_object_get_object(json_object(json), "Data"), "value");
+	C2DCommand command = {.value = 0};
+	JSON_Field_Status statuses[sizeof(c2dCommandFields) / sizeof(*c2dCommandFields)];
+	// Data.value may be missing, but nothing decoded from a message that is not valid JSON is used
+	if (json_decode_buffer(payload, payloadSize, c2dCommandFields, c2dCommandFieldsCount, &command,
+	                       statuses) != JSONSuccess &&
+	    statuses[0] == JSONFieldInvalid) {
+		Log_Debug("WARNING: Message is not valid JSON.\n");
+		return;
+	}
+	 statuts = (int)command.value;
 
-	 if (commande==NULL)
+	 if (statuses[0] != JSONFieldDecoded)
 	 {
-		 return 0; 
+		 Log_Debug("WARNING: Message without a valid Data.type command.\n");
+		 return; 
 	 }
 	 else
 	 {
+		 const char *commande = command.type;
 		 if (strcmp(commande, "SetLight") == 0)
 		 {
 			 if (statuts == 1) {
@@ -476,8 +555,6 @@ static void MessageReceived(const char *payload)
 		 {
 			 Log_Debug("error \n");
 		 }
-
-		 json_value_free(json);
 	 }
     // Set the send/receive LED2 to blink once immediately to indicate a message has been received.
     BlinkLed2Once();
@@ -496,7 +573,7 @@ static void DeviceTwinUpdate(JSON_Object *desiredProperties)
     // If the attribute is missing or its type is not a number.
     if (blinkRateJson == NULL) {
         Log_Debug(
-            "INFO: A device twin update was received that did not contain the property "
+            "INFO: A device twin update was received that did not change the property "
             "\"LedBlinkRateProperty\".\n");
     } else if (json_value_get_type(blinkRateJson) != JSONNumber) {
         Log_Debug(
@@ -576,15 +653,8 @@ static int DirectMethodCall(const char *methodName, const char *payload, size_t
 
     RgbLedUtility_Colors ledColor = RgbLedUtility_Colors_Unknown;
     // The payload should contains JSON such as: { "color": "red"}
-    char *directMethodCallContent = malloc(payloadSize + 1); // +1 to store null char at the end.
-    if (directMethodCallContent == NULL) {
-        Log_Debug("ERROR: Could not allocate buffer for direct method request payload.\n");
-        abort();
-    }
-
-    memcpy(directMethodCallContent, payload, payloadSize);
-    directMethodCallContent[payloadSize] = 0; // Null terminated string.
-    JSON_Value *payloadJson = json_parse_string(directMethodCallContent);
+    // It is not null terminated, the parser is bounded by its size instead.
+    JSON_Value *payloadJson = json_parse_buffer(payload, payloadSize);
     if (payloadJson == NULL) {
         goto colorNotFound;
     }
@@ -598,6 +668,8 @@ static int DirectMethodCall(const char *methodName, const char *payload, size_t
     }
 
     ledColor = RgbLedUtility_GetColorFromString(colorName, strlen(colorName));
+    json_value_free(payloadJson);
+    payloadJson = NULL;
 
     // If color's name has not been identified.
     if (ledColor == RgbLedUtility_Colors_Unknown) {
@@ -613,7 +685,7 @@ static int DirectMethodCall(const char *methodName, const char *payload, size_t
 
     static const char colorOkResponse[] =
         "{ \"success\" : true, \"message\" : \"led color set to %s\" }";
-    size_t responseMaxLength = sizeof(colorOkResponse) + strlen(payload);
+    size_t responseMaxLength = sizeof(colorOkResponse) + strlen(colorString);
     *responsePayload = SetupHeapMessage(colorOkResponse, responseMaxLength, colorString);
     if (*responsePayload == NULL) {
         Log_Debug("ERROR: Could not allocate buffer for direct method response payload.\n");
@@ -624,6 +696,7 @@ static int DirectMethodCall(const char *methodName, const char *payload, size_t
     return result;
 
 colorNotFound:
+    json_value_free(payloadJson);
     result = 400; // Bad request.
     Log_Debug("INFO: Unrecognised direct method payload format.\n");
 
@@ -676,32 +749,9 @@ static void Led1UpdateHandler(event_data_t *eventData)
 	float temp = GroveTempHumiSHT31_GetTemperature(sht31);
 	float humi = GroveTempHumiSHT31_GetHumidity(sht31);
 
-	char a[50] = "\173\"type\":\"Reading\",\"origin\":\"Sphere\",\"timestamp\":";
-	char c[50] = ",\"data\":\173\"type\":\"Temperature\",\"value\": ";
-	char c1[50] = ",\"data\":\173\"type\":\"Humidity\",\"value\": ";
-	char e[10] = " \175\175";
-	char f[10];
-	char f1[10];
-	char d[200];
-	char d1[200];
-
-	strcpy(d, a);
-	strcat(d, GetTimestamp());
-	strcat(d, c);
-	sprintf(f, "%f", temp);
-	strcat(d, f);
-	strcat(d, e);
-	
-	SendMessageToIotHub(d);
-
-	strcpy(d1, a);
-	strcat(d1, GetTimestamp());
-	strcat(d1, c1);
-	sprintf(f1, "%f", humi);
-	strcat(d1, f1);
-	strcat(d1, e);
-	sprintf(f1, "%f", humi);
-	SendMessageToIotHub(d1);
+	// The sensor is accurate to about 0.2C and 2%RH, more decimals would only make payloads longer
+	SendReadingToIotHub("Temperature", temp, 2);
+	SendReadingToIotHub("Humidity", humi, 1);
 	Log_Debug("Temperature: %.1fC\n", temp);
 	Log_Debug("Humidity: %.1f\%c\n", humi, 0x25);
 }
@@ -833,6 +883,11 @@ static int InitPeripheralsAndHandlers(void)
 		Log_Debug("ERROR: Could not open UART: %s (%d).\n", strerror(errno), errno);
 		return -1;
 	}
+	uartStream = json_stream_create();
+	if (uartStream == NULL) {
+		Log_Debug("ERROR: Could not create the UART JSON stream.\n");
+		return -1;
+	}
 	// Put into the epoll
 	if (RegisterEventHandlerToEpoll(epollFd, uartFd, &uartEventData, EPOLLIN) != 0) {
 		return -1;
@@ -944,6 +999,7 @@ static void ClosePeripheralsAndHandlers(void)
 	CloseFdAndPrintError(OLEDTimerFd, "OLEDTimerFd");
 	CloseFdAndPrintError(gpioLed2TimerFd, "Led2Timer");
     CloseFdAndPrintError(epollFd, "Epoll");
+    json_stream_free(uartStream);
 	
     // Close the LEDs and leave then off
     RgbLedUtility_CloseLeds(rgbLeds, rgbLedsCount);
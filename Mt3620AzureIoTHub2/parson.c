@@ -41,6 +41,20 @@
 #include <ctype.h>
 #include <math.h>
 #include <errno.h>
+#include <stdint.h>
+#include <limits.h>
+
+/* Strings are scanned 16 bytes at a time with SSE2 or NEON when the compiler targets them, and a
+   machine word at a time otherwise. Define PARSON_NO_SIMD to use the word-at-a-time scan only. */
+#if !defined(PARSON_NO_SIMD)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PARSON_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define PARSON_NEON
+#endif
+#endif /* PARSON_NO_SIMD */
 
 /* Apparently sscanf is not implemented in some "standard" libraries, so don't use it, if you
  * don't have to. */
@@ -49,23 +63,86 @@
 #define STARTING_CAPACITY 16
 #define MAX_NESTING 2048
 
-#define FLOAT_FORMAT "%1.17g" /* do not increase precision without incresing NUM_BUF_SIZE */
-/* double printed with "%1.17g" shouldn't be longer than 25 bytes so let's use 64 */
+/* CBOR major types, and the additional information of simple values and floats */
+#define CBOR_UNSIGNED 0
+#define CBOR_NEGATIVE 1
+#define CBOR_BYTES 2
+#define CBOR_TEXT 3
+#define CBOR_ARRAY 4
+#define CBOR_MAP 5
+#define CBOR_TAG 6
+#define CBOR_SIMPLE 7
+#define CBOR_FALSE 20
+#define CBOR_TRUE 21
+#define CBOR_NULL 22
+#define CBOR_HALF 25
+#define CBOR_SINGLE 26
+#define CBOR_DOUBLE 27
+#define CBOR_TWO_TO_64 18446744073709551616.0
+#define CBOR_FLOAT_MAX 3.4028234663852886e38
+
+/* States of an incremental parser: what the next character may be */
+#define STREAM_VALUE 0             /* a value */
+#define STREAM_VALUE_OR_END 1      /* a value or ']', after '[' */
+#define STREAM_NAME 2              /* a quoted name, after ',' in an object */
+#define STREAM_NAME_OR_END 3       /* a quoted name or '}', after '{' */
+#define STREAM_COLON 4
+#define STREAM_COMMA_OR_END 5      /* ',' or the closing bracket, after a member or an item */
+#define STREAM_STRING 6            /* inside a string token */
+#define STREAM_NUMBER 7            /* inside a number token */
+#define STREAM_LITERAL 8           /* inside true, false or null */
+#define STREAM_COMPLETE 9          /* a whole value has been read and not taken yet */
+#define STREAM_ERROR 10
+#define STREAM_TOKEN_MIN_CAPACITY 64
+
+#define ARENA_DEFAULT_BLOCK_SIZE 4096
+#define ARENA_ALIGNMENT 8 /* enough for double and pointers */
+#define ARENA_ALIGN(size) (((size) + (ARENA_ALIGNMENT - 1)) & ~(size_t)(ARENA_ALIGNMENT - 1))
+
+#define VALUE_FLAG_ARENA 0x01    /* value and its string live in an arena */
+#define VALUE_FLAG_BORROWED 0x02 /* string points into an in-situ parsed input */
+#define VALUE_FLAG_INLINE 0x04   /* string is stored in the payload of the value */
+#define VALUE_FLAG_LAZY 0x08     /* container whose members are not parsed yet */
+#define VALUE_FLAG_FIXED 0x10    /* number has its decimals stored after it in the payload */
+
+/* 14 bytes on 64-bit and 10 bytes on 32-bit targets fill the value up to its alignment */
+#define VALUE_PAYLOAD_SIZE (sizeof(double) + sizeof(void *) - 2)
+
+#define OBJECT_INDEX_THRESHOLD 16 /* smaller objects are searched linearly */
+#define OBJECT_INDEX_NOT_FOUND ((size_t)-1)
+
+/* formatted doubles are at most 25 bytes long ("-0.0000012345678901234567") so let's use 64 */
 #define NUM_BUF_SIZE 64
+#define NUMBER_DECIMALS_MAX 15 /* 10^15 and the rounded digits are exact in a double */
+
+#define INTERN_TABLE_MIN_CELLS 64
+#define INTERN_NAME_BUF_SIZE 64 /* longer names are unescaped into a temporary copy */
+
+#define WRITER_DEFAULT_CAPACITY 256
+#define SINK_BUFFER_SIZE 128 /* on the stack of json_serialize_to_sink */
+#define INDEX_STACK_INLINE_SIZE 32 /* levels the serializer walks without allocating */
+
+#define DECODER_MAX_DEPTH 16 /* fields nested deeper are never found */
+#define COUNT_MEMBERS_MIN_LENGTH 1024 /* shorter inputs grow their containers while parsing */
 
 #define SIZEOF_TOKEN(a) (sizeof(a) - 1)
 #define SKIP_CHAR(str) ((*str)++)
-#define SKIP_WHITESPACES(str)                 \
-    while (isspace((unsigned char)(**str))) { \
-        SKIP_CHAR(str);                       \
-    }
+#define SKIP_WHITESPACES(str, end) (*(str) = skip_whitespaces(*(str), (end)))
+#define CURRENT_CHAR(str, end) (*(str) < (end) ? **(str) : '\0') /* '\0' past the end */
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
 
 #undef malloc
 #undef free
 
 static JSON_Malloc_Function parson_malloc = malloc;
 static JSON_Free_Function parson_free = free;
+static JSON_Intern_Table *parson_intern_table = NULL;
+static size_t parson_nesting_limit = MAX_NESTING;
+
+/* SWAR: a word with every byte set to b, and whether any byte of word x is below n (n <= 128) */
+#define WORD_REPEAT(b) ((size_t)-1 / 0xFF * (b))
+#define WORD_HAS_LESS(x, n) (((x) - WORD_REPEAT(n)) & ~(x) & WORD_REPEAT(0x80))
 
 #define IS_CONT(b) (((unsigned char)(b)&0xC0) == 0x80) /* is utf-8 continuation byte */
 
@@ -79,44 +156,205 @@ typedef union json_value_value {
     int null;
 } JSON_Value_Value;
 
+/* The payload holds a JSON_Value_Value, or the characters of a string shorter than
+   VALUE_PAYLOAD_SIZE. It is copied in and out with memcpy, so it needs no alignment and packs right
+   after type and flags. */
 struct json_value_t {
     JSON_Value *parent;
-    JSON_Value_Type type;
-    JSON_Value_Value value;
+    unsigned char type; /* JSON_Value_Type, packed together with flags */
+    unsigned char flags;
+    char payload[VALUE_PAYLOAD_SIZE];
 };
 
+typedef struct json_object_cell_t {
+    unsigned long hash;
+    size_t item; /* index of the name-value pair plus one, 0 marks an empty cell */
+} JSON_Object_Cell;
+
 struct json_object_t {
     JSON_Value *wrapping_value;
+    JSON_Arena *arena; /* NULL when names and values are heap allocated */
     char **names;
     JSON_Value **values;
+    JSON_Object_Cell *cells; /* open addressing hash index of names, NULL for small objects */
+    size_t cell_count;       /* power of two, at least twice the count */
     size_t count;
     size_t capacity;
+    int borrowed_names; /* names point into an in-situ parsed input and are not freed */
+    JSON_Intern_Table *intern_table; /* names are shared from this table and not freed */
 };
 
 struct json_array_t {
     JSON_Value *wrapping_value;
+    JSON_Arena *arena;
     JSON_Value **items;
     size_t count;
     size_t capacity;
 };
 
+typedef struct json_arena_block_t {
+    struct json_arena_block_t *next;
+    size_t size; /* usable bytes following the header */
+    size_t used;
+} JSON_Arena_Block;
+
+struct json_arena_t {
+    JSON_Arena_Block *blocks; /* block currently bump-allocated from comes first */
+    size_t block_size;
+};
+
+typedef struct json_intern_cell_t {
+    unsigned long hash;
+    char *name; /* NULL marks an empty cell */
+} JSON_Intern_Cell;
+
+struct json_intern_table_t {
+    JSON_Intern_Cell *cells; /* open addressing, like the hash index of objects */
+    size_t cell_count;       /* power of two, at least twice the count */
+    size_t count;
+};
+
+typedef struct json_index_stack_t {
+    size_t *items; /* inline_items until more are pushed */
+    size_t count;
+    size_t capacity;
+    size_t inline_items[INDEX_STACK_INLINE_SIZE];
+} JSON_Index_Stack;
+
+typedef struct json_parser_t {
+    JSON_Arena *arena; /* NULL when parsing onto the heap */
+    int insitu;        /* strings are unescaped in place and borrowed from the input */
+    const char *end;   /* the input is never read at or past end */
+    const JSON_Index_Stack *member_counts; /* of every container, in the order they open */
+    size_t next_container;                 /* index in member_counts of the next one to open */
+} JSON_Parser;
+
+struct json_writer_t {
+    char *buf;       /* NULL when only measuring */
+    size_t length;   /* bytes written, without the terminating '\0' */
+    size_t capacity; /* size of buf */
+    int can_grow;    /* buf belongs to the writer and is replaced by a larger one when full */
+    JSON_Sink_Function sink; /* when set, buf is a scratch buffer flushed to it when full */
+    void *sink_context;
+};
+
+typedef struct json_decoder_t {
+    const JSON_Field *fields;
+    size_t field_count;
+    char *target;
+    JSON_Field_Status *statuses;
+    const char *names[DECODER_MAX_DEPTH]; /* escaped name of the member at each depth */
+    size_t name_lengths[DECODER_MAX_DEPTH];  /* names of array items are NULL */
+} JSON_Decoder;
+
+typedef struct json_path_segment_t {
+    const char *name; /* not terminated, points into the copy of the path */
+    size_t length;
+    unsigned long hash;
+} JSON_Path_Segment;
+
+struct json_path_t {
+    size_t count;
+    JSON_Path_Segment *segments; /* followed by the copy of the path, in the same allocation */
+};
+
+typedef struct json_diy_fp_t {
+    uint64_t f;
+    int e; /* the value is f * 2^e */
+} JSON_Diy_Fp;
+
+typedef struct json_cached_power_t {
+    uint64_t f;
+    int e;
+    int k; /* the value is f * 2^e, approximately 10^k */
+} JSON_Cached_Power;
+
+typedef struct json_event_parser_t {
+    JSON_Event_Handler handler;
+    void *context;
+    const char *end;
+    int stopped; /* set when the handler asked to stop */
+} JSON_Event_Parser;
+
+typedef struct json_stream_frame_t {
+    JSON_Value *value; /* object or array still open, already attached to its parent */
+    char *name;        /* name of the next member of an object, NULL until it has been read */
+} JSON_Stream_Frame;
+
+struct json_stream_t {
+    int state;
+    JSON_Value *root;          /* NULL until the first character of a value */
+    JSON_Stream_Frame *frames; /* open containers, innermost last */
+    size_t frame_count;
+    size_t frame_capacity;
+    char *token;               /* escaped string, number or literal read so far */
+    size_t token_length;
+    size_t token_capacity;
+    int token_is_name;
+    int escaped;               /* the string token ends with a backslash whose sequence is unread */
+};
+
+typedef struct json_tape_entry_t {
+    size_t start; /* offset of the first character after the opening bracket */
+    size_t end;   /* offset of the first character after the closing bracket */
+    size_t count; /* members */
+    size_t next;  /* index of the first entry past the members of this container */
+} JSON_Tape_Entry;
+
+/* Structural index of a lazily parsed document, shared by all of its unparsed containers */
+typedef struct json_tape_t {
+    char *text;               /* copy of the input */
+    JSON_Tape_Entry *entries; /* every container, in the order they open */
+    size_t count;
+    size_t capacity;
+    size_t refs;              /* unparsed containers still pointing at the tape */
+} JSON_Tape;
+
+/* Arena */
+static void *arena_malloc(JSON_Arena *arena, size_t n);
+static void arena_free(JSON_Arena *arena, void *ptr);
+static char *arena_strndup(JSON_Arena *arena, const char *string, size_t n);
+
+/* Name interning */
+static JSON_Status intern_table_grow(JSON_Intern_Table *table);
+static char *intern_table_get(JSON_Intern_Table *table, const char *name, size_t name_len);
+
 /* Various */
 static void remove_comments(char *string, const char *start_token, const char *end_token);
 static char *parson_strndup(const char *string, size_t n);
-static char *parson_strdup(const char *string);
 static int hex_char_to_int(char c);
 static int parse_utf16_hex(const char *string, unsigned int *result);
-static int num_bytes_in_utf8_sequence(unsigned char c);
-static int verify_utf8_sequence(const unsigned char *string, int *len);
+static size_t utf8_sequence_length(const unsigned char *string, size_t available);
 static int is_valid_utf8(const char *string, size_t string_len);
 static int is_decimal(const char *string, size_t length);
+static const char *skip_whitespaces(const char *string, const char *end);
+static size_t scan_plain_chars(const char *string, const char *end, int ascii_only);
+static size_t scan_valid_chars(const char *string, const char *end);
+static unsigned long hash_string(const char *string, size_t n);
 
 /* JSON Object */
-static JSON_Object *json_object_init(JSON_Value *wrapping_value);
+static JSON_Object *json_object_init(JSON_Value *wrapping_value, JSON_Arena *arena);
 static JSON_Status json_object_add(JSON_Object *object, const char *name, JSON_Value *value);
 static JSON_Status json_object_addn(JSON_Object *object, const char *name, size_t name_len,
                                     JSON_Value *value);
+static JSON_Status json_object_append_unique(JSON_Object *object, char *name, size_t name_len,
+                                             JSON_Value *value);
+static JSON_Status json_object_append_hashed(JSON_Object *object, char *name, JSON_Value *value,
+                                             unsigned long hash);
+static unsigned long json_object_name_hash(const JSON_Object *object, const char *name,
+                                           size_t name_len);
+static JSON_Status json_object_own_names(JSON_Object *object);
+static char *json_object_copy_name(JSON_Object *object, const char *name, size_t name_len);
+static void json_object_free_name(JSON_Object *object, char *name);
 static JSON_Status json_object_resize(JSON_Object *object, size_t new_capacity);
+static JSON_Status json_object_shrink(JSON_Object *object);
+static JSON_Status json_object_index_rebuild(JSON_Object *object, size_t cell_count);
+static void json_object_index_insert(JSON_Object *object, size_t item_index, unsigned long hash);
+static void json_object_index_remove(JSON_Object *object, size_t item_index);
+static size_t json_object_getn_index(const JSON_Object *object, const char *name,
+                                     size_t name_len);
+static size_t json_object_getn_index_hashed(const JSON_Object *object, const char *name,
+                                            size_t name_len, unsigned long hash);
 static JSON_Value *json_object_getn_value(const JSON_Object *object, const char *name,
                                           size_t name_len);
 static JSON_Status json_object_remove_internal(JSON_Object *object, const char *name,
@@ -126,38 +364,194 @@ static JSON_Status json_object_dotremove_internal(JSON_Object *object, const cha
 static void json_object_free(JSON_Object *object);
 
 /* JSON Array */
-static JSON_Array *json_array_init(JSON_Value *wrapping_value);
+static JSON_Array *json_array_init(JSON_Value *wrapping_value, JSON_Arena *arena);
 static JSON_Status json_array_add(JSON_Array *array, JSON_Value *value);
 static JSON_Status json_array_resize(JSON_Array *array, size_t new_capacity);
+static JSON_Status json_array_shrink(JSON_Array *array);
 static void json_array_free(JSON_Array *array);
 
 /* JSON Value */
-static JSON_Value *json_value_init_string_no_copy(char *string);
+static JSON_Value *json_value_alloc(JSON_Arena *arena, JSON_Value_Type type);
+static JSON_Value_Value json_value_get_payload(const JSON_Value *value);
+static void json_value_set_payload(JSON_Value *value, JSON_Value_Value payload);
+static JSON_Value *json_value_init_object_arena(JSON_Arena *arena);
+static JSON_Value *json_value_init_array_arena(JSON_Arena *arena);
+static JSON_Value *json_value_init_string_no_copy(JSON_Arena *arena, char *string);
+static JSON_Value *json_value_init_string_copy(JSON_Arena *arena, const char *string, size_t len);
+static JSON_Value *json_value_init_number_arena(JSON_Arena *arena, double number);
+static JSON_Value *json_value_init_boolean_arena(JSON_Arena *arena, int boolean);
+static JSON_Value *json_value_init_null_arena(JSON_Arena *arena);
 
 /* Parser */
-static JSON_Status skip_quotes(const char **string);
-static int parse_utf16(const char **unprocessed, char **processed);
-static char *process_string(const char *input, size_t len);
-static char *get_quoted_string(const char **string);
-static JSON_Value *parse_object_value(const char **string, size_t nesting);
-static JSON_Value *parse_array_value(const char **string, size_t nesting);
-static JSON_Value *parse_string_value(const char **string);
-static JSON_Value *parse_boolean_value(const char **string);
-static JSON_Value *parse_number_value(const char **string);
-static JSON_Value *parse_null_value(const char **string);
-static JSON_Value *parse_value(const char **string, size_t nesting);
+static JSON_Status skip_quotes(const char **string, const char *end);
+static int parse_utf16(const char **unprocessed, char **processed, const char *end);
+static JSON_Status unescape_sequence(const char **input, char **output, const char *end);
+static JSON_Status unescape_string(const char *input, size_t len, char *output, size_t *output_len);
+static char *process_string(const char *input, size_t len, JSON_Parser *parser);
+static char *get_quoted_string(const char **string, JSON_Parser *parser);
+static void free_quoted_string(char *string, JSON_Parser *parser);
+static char *get_quoted_name(const char **string, JSON_Object *object, JSON_Parser *parser);
+static char *parse_member_name(const char **string, JSON_Object *object, JSON_Parser *parser);
+static JSON_Status count_members(const char *string, const char *end, JSON_Index_Stack *counts);
+static size_t parse_member_count(JSON_Parser *parser, const char *string, size_t min_size);
+static JSON_Value *parse_value_start(const char **string, JSON_Parser *parser);
+static JSON_Status parse_attach(JSON_Value *container, char *name, JSON_Value *value);
+static JSON_Value *parse_string_value(const char **string, JSON_Parser *parser);
+static JSON_Value *parse_boolean_value(const char **string, JSON_Parser *parser);
+static JSON_Value *parse_number_value(const char **string, JSON_Parser *parser);
+static JSON_Value *parse_null_value(const char **string, JSON_Parser *parser);
+static JSON_Value *parse_value(const char **string, JSON_Parser *parser);
+static JSON_Value *parse_root(const char *string, size_t length, JSON_Arena *arena, int insitu);
+static int skip_token(const char **string, const char *end, const char *token, size_t token_size);
+static JSON_Status parse_number(const char **string, const char *end, double *number);
+static int parse_number_fast(const char **string, const char *end, double *number);
+
+/* Event parser */
+static JSON_Status emit_event(JSON_Event_Parser *parser, JSON_Event *event);
+static JSON_Status parse_event_key(const char **string, size_t depth, JSON_Event_Parser *parser);
+static JSON_Status parse_event_scalar(const char **string, size_t depth, JSON_Event_Parser *parser);
+static JSON_Status parse_events(const char **string, JSON_Event_Parser *parser);
+
+/* Incremental parser */
+static JSON_Status stream_token_append(JSON_Stream *stream, const char *chars, size_t n);
+static void stream_fail(JSON_Stream *stream);
+static void stream_value_done(JSON_Stream *stream);
+static JSON_Status stream_attach(JSON_Stream *stream, JSON_Value *value);
+static JSON_Status stream_close(JSON_Stream *stream);
+static JSON_Status stream_finish_string(JSON_Stream *stream);
+static JSON_Status stream_finish_number(JSON_Stream *stream);
+static JSON_Status stream_start_value(JSON_Stream *stream, char c);
+static const char *stream_step(JSON_Stream *stream, const char *ptr, const char *end);
+
+/* Lazy parser */
+static JSON_Status tape_push(JSON_Tape *tape, size_t start);
+static void tape_release(JSON_Tape *tape);
+static JSON_Status tape_skip_string(const char **string, const char *end);
+static JSON_Status tape_skip_name(const char **string, const char *end);
+static JSON_Status tape_build(JSON_Tape *tape, const char *string, const char *end);
+static JSON_Value *lazy_value_init(JSON_Tape *tape, size_t index);
+static JSON_Tape *lazy_value_get_tape(const JSON_Value *value, size_t *index);
+static JSON_Status lazy_materialize(JSON_Value *value);
+
+/* Comparing */
+static int values_equal(const JSON_Value *a, const JSON_Value *b, int exact);
+
+/* Merge patch */
+static JSON_Status merge_patch_object(JSON_Object *target, const JSON_Object *patch);
+static JSON_Status diff_object(const JSON_Object *old_object, const JSON_Object *new_object,
+                               JSON_Object *patch);
+
+/* Hashing */
+static unsigned long hash_mix(unsigned long hash);
+
+/* Decoding into structs */
+static int escaped_name_equals(const char *escaped, size_t escaped_len, const char *name,
+                               size_t name_len);
+static int decoder_path_matches(const JSON_Decoder *decoder, const char *path, size_t depth);
+static void decoder_store(JSON_Decoder *decoder, size_t field_index, const JSON_Event *event);
+static int decoder_handle_event(const JSON_Event *event, void *context);
+
+/* Number formatting */
+static JSON_Diy_Fp diy_fp_sub(JSON_Diy_Fp x, JSON_Diy_Fp y);
+static JSON_Diy_Fp diy_fp_mul(JSON_Diy_Fp x, JSON_Diy_Fp y);
+static JSON_Diy_Fp diy_fp_normalize(JSON_Diy_Fp x);
+static void compute_boundaries(double value, JSON_Diy_Fp *v, JSON_Diy_Fp *m_minus,
+                               JSON_Diy_Fp *m_plus);
+static const JSON_Cached_Power *get_cached_power(int e);
+static void grisu2_round(char *buf, int len, uint64_t dist, uint64_t delta, uint64_t rest,
+                         uint64_t ten_k);
+static int grisu2_digit_gen(char *buf, int *decimal_exponent, JSON_Diy_Fp m_minus, JSON_Diy_Fp w,
+                            JSON_Diy_Fp m_plus);
+static int grisu2(char *buf, int *decimal_exponent, double value);
+static int format_number(char *buf, double number);
+static int format_number_fixed(char *buf, double number, int decimals);
 
 /* Serialization */
-static int json_serialize_to_buffer_r(const JSON_Value *value, char *buf, int level, int is_pretty,
-                                      char *num_buf);
-static int json_serialize_string(const char *string, char *buf);
-static int append_indent(char *buf, int level);
-static int append_string(char *buf, const char *string);
+static void writer_init(JSON_Writer *writer, char *buf, size_t capacity, int can_grow);
+static JSON_Status writer_reserve(JSON_Writer *writer, size_t n);
+static JSON_Status writer_append(JSON_Writer *writer, const char *data, size_t n);
+static JSON_Status writer_flush(JSON_Writer *writer);
+static JSON_Status writer_append_to_sink(JSON_Writer *writer, const char *data, size_t n);
+static JSON_Status serialize_to_sink(const JSON_Value *value, JSON_Sink_Function sink,
+                                     void *context, int is_pretty);
+static JSON_Status writer_append_number(JSON_Writer *writer, double number, int decimals);
+static void writer_terminate(JSON_Writer *writer);
+
+/* CBOR */
+static JSON_Status cbor_write_head(JSON_Writer *writer, unsigned int major, uint64_t argument);
+static JSON_Status cbor_write_argument(JSON_Writer *writer, unsigned int initial_byte,
+                                       uint64_t argument, size_t size);
+static JSON_Status cbor_write_number(JSON_Writer *writer, double number);
+static JSON_Status cbor_write_item(const JSON_Value *value, JSON_Writer *writer);
+static const JSON_Value *cbor_write_member_start(const JSON_Value *container, size_t index,
+                                                 JSON_Writer *writer);
+static JSON_Status cbor_serialize_value(const JSON_Value *value, JSON_Writer *writer);
+static JSON_Status cbor_read_head(const unsigned char **data, const unsigned char *end,
+                                  unsigned int *major, unsigned int *info, uint64_t *argument);
+static double cbor_half_to_double(unsigned int half);
+static int cbor_is_valid_text(const unsigned char *data, size_t length);
+static JSON_Value *cbor_parse_item(const unsigned char **data, const unsigned char *end,
+                                   size_t nesting, size_t *count);
+static char *cbor_parse_name(const unsigned char **data, const unsigned char *end,
+                             JSON_Object *object, size_t *length);
+static JSON_Value *cbor_parse_value(const unsigned char **data, const unsigned char *end);
+static void index_stack_init(JSON_Index_Stack *stack);
+static JSON_Status index_stack_push(JSON_Index_Stack *stack, size_t index);
+static void index_stack_free(JSON_Index_Stack *stack);
+static size_t json_value_get_member_count(const JSON_Value *value);
+static JSON_Value *json_value_get_member_at(const JSON_Value *container, size_t index);
+static const JSON_Value *serialize_member_start(const JSON_Value *container, size_t index,
+                                                JSON_Writer *writer, size_t level, int is_pretty);
+static JSON_Status serialize_leaf(const JSON_Value *value, JSON_Writer *writer);
+static JSON_Status json_serialize_value(const JSON_Value *value, JSON_Writer *writer,
+                                        int is_pretty);
+static JSON_Status json_serialize_string(const char *string, JSON_Writer *writer);
+static JSON_Status append_indent(JSON_Writer *writer, int level);
+
+/* Arena */
+static void *arena_malloc(JSON_Arena *arena, size_t n)
+{
+    JSON_Arena_Block *block = NULL;
+    size_t header_size = ARENA_ALIGN(sizeof(JSON_Arena_Block)), block_size = 0;
+    void *ptr = NULL;
+    if (arena == NULL) {
+        return parson_malloc(n);
+    }
+    n = ARENA_ALIGN(n);
+    block = arena->blocks;
+    if (block != NULL && block->size - block->used >= n) {
+        ptr = (char *)block + header_size + block->used;
+        block->used += n;
+        return ptr;
+    }
+    block_size = MAX(arena->block_size, n);
+    block = (JSON_Arena_Block *)parson_malloc(header_size + block_size);
+    if (block == NULL) {
+        return NULL;
+    }
+    block->size = block_size;
+    block->used = n;
+    if (n > arena->block_size / 4 && arena->blocks != NULL) {
+        /* Oversized request, keep bump-allocating from the current block */
+        block->next = arena->blocks->next;
+        arena->blocks->next = block;
+    } else {
+        block->next = arena->blocks;
+        arena->blocks = block;
+    }
+    return (char *)block + header_size;
+}
 
-/* Various */
-static char *parson_strndup(const char *string, size_t n)
+static void arena_free(JSON_Arena *arena, void *ptr)
+{
+    if (arena == NULL) { /* arena memory is only released by json_arena_reset */
+        parson_free(ptr);
+    }
+}
+
+static char *arena_strndup(JSON_Arena *arena, const char *string, size_t n)
 {
-    char *output_string = (char *)parson_malloc(n + 1);
+    char *output_string = (char *)arena_malloc(arena, n + 1);
     if (!output_string) {
         return NULL;
     }
@@ -166,9 +560,65 @@ static char *parson_strndup(const char *string, size_t n)
     return output_string;
 }
 
-static char *parson_strdup(const char *string)
+/* Name interning */
+static JSON_Status intern_table_grow(JSON_Intern_Table *table)
+{
+    JSON_Intern_Cell *old_cells = table->cells;
+    size_t old_cell_count = table->cell_count, i, mask, cell;
+    size_t cell_count = MAX(old_cell_count * 2, INTERN_TABLE_MIN_CELLS);
+    JSON_Intern_Cell *cells =
+        (JSON_Intern_Cell *)parson_malloc(cell_count * sizeof(JSON_Intern_Cell));
+    if (cells == NULL) {
+        return JSONFailure;
+    }
+    memset(cells, 0, cell_count * sizeof(JSON_Intern_Cell));
+    mask = cell_count - 1;
+    for (i = 0; i < old_cell_count; i++) {
+        if (old_cells[i].name == NULL) {
+            continue;
+        }
+        for (cell = (size_t)old_cells[i].hash & mask; cells[cell].name != NULL;
+             cell = (cell + 1) & mask) {
+        }
+        cells[cell] = old_cells[i];
+    }
+    parson_free(old_cells);
+    table->cells = cells;
+    table->cell_count = cell_count;
+    return JSONSuccess;
+}
+
+/* Returns the copy of name held by table, adding one if there is none yet */
+static char *intern_table_get(JSON_Intern_Table *table, const char *name, size_t name_len)
+{
+    unsigned long hash = hash_string(name, name_len);
+    size_t mask, cell;
+    char *new_name = NULL;
+    if ((table->count + 1) * 2 > table->cell_count && intern_table_grow(table) == JSONFailure) {
+        return NULL;
+    }
+    mask = table->cell_count - 1;
+    for (cell = (size_t)hash & mask; table->cells[cell].name != NULL; cell = (cell + 1) & mask) {
+        if (table->cells[cell].hash == hash &&
+            strncmp(table->cells[cell].name, name, name_len) == 0 &&
+            table->cells[cell].name[name_len] == '\0') {
+            return table->cells[cell].name;
+        }
+    }
+    new_name = parson_strndup(name, name_len);
+    if (new_name == NULL) {
+        return NULL;
+    }
+    table->cells[cell].hash = hash;
+    table->cells[cell].name = new_name;
+    table->count++;
+    return new_name;
+}
+
+/* Various */
+static char *parson_strndup(const char *string, size_t n)
 {
-    return parson_strndup(string, strlen(string));
+    return arena_strndup(NULL, string, n);
 }
 
 static int hex_char_to_int(char c)
@@ -200,69 +650,50 @@ static int parse_utf16_hex(const char *s, unsigned int *result)
     return 1;
 }
 
-static int num_bytes_in_utf8_sequence(unsigned char c)
+/* Length of the valid UTF-8 sequence at string, 0 when it is invalid or longer than available.
+   The ranges of the second byte from table 3-7 of the Unicode standard rule out overlong
+   encodings, surrogate halves and code points past U+10FFFF without decoding. */
+static size_t utf8_sequence_length(const unsigned char *string, size_t available)
 {
-    if (c == 0xC0 || c == 0xC1 || c > 0xF4 || IS_CONT(c)) {
-        return 0;
-    } else if ((c & 0x80) == 0) { /* 0xxxxxxx */
+    unsigned char lead = string[0];
+    if (lead < 0x80) {
         return 1;
-    } else if ((c & 0xE0) == 0xC0) { /* 110xxxxx */
-        return 2;
-    } else if ((c & 0xF0) == 0xE0) { /* 1110xxxx */
-        return 3;
-    } else if ((c & 0xF8) == 0xF0) { /* 11110xxx */
-        return 4;
-    }
-    return 0; /* won't happen */
-}
-
-static int verify_utf8_sequence(const unsigned char *string, int *len)
-{
-    unsigned int cp = 0;
-    *len = num_bytes_in_utf8_sequence(string[0]);
-
-    if (*len == 1) {
-        cp = string[0];
-    } else if (*len == 2 && IS_CONT(string[1])) {
-        cp = string[0] & 0x1F;
-        cp = (cp << 6) | (string[1] & 0x3F);
-    } else if (*len == 3 && IS_CONT(string[1]) && IS_CONT(string[2])) {
-        cp = ((unsigned char)string[0]) & 0xF;
-        cp = (cp << 6) | (string[1] & 0x3F);
-        cp = (cp << 6) | (string[2] & 0x3F);
-    } else if (*len == 4 && IS_CONT(string[1]) && IS_CONT(string[2]) && IS_CONT(string[3])) {
-        cp = string[0] & 0x7;
-        cp = (cp << 6) | (string[1] & 0x3F);
-        cp = (cp << 6) | (string[2] & 0x3F);
-        cp = (cp << 6) | (string[3] & 0x3F);
-    } else {
-        return 0;
-    }
-
-    /* overlong encodings */
-    if ((cp < 0x80 && *len > 1) || (cp < 0x800 && *len > 2) || (cp < 0x10000 && *len > 3)) {
-        return 0;
-    }
-
-    /* invalid unicode */
-    if (cp > 0x10FFFF) {
-        return 0;
-    }
-
-    /* surrogate halves */
-    if (cp >= 0xD800 && cp <= 0xDFFF) {
-        return 0;
-    }
-
-    return 1;
+    } else if (lead < 0xE0) {
+        return lead >= 0xC2 && available >= 2 && IS_CONT(string[1]) ? 2 : 0;
+    } else if (lead < 0xF0) {
+        return available >= 3 && IS_CONT(string[1]) && IS_CONT(string[2]) &&
+                       (lead != 0xE0 || string[1] >= 0xA0) && (lead != 0xED || string[1] <= 0x9F)
+                   ? 3
+                   : 0;
+    }
+    return lead <= 0xF4 && available >= 4 && IS_CONT(string[1]) && IS_CONT(string[2]) &&
+                   IS_CONT(string[3]) && (lead != 0xF0 || string[1] >= 0x90) &&
+                   (lead != 0xF4 || string[1] <= 0x8F)
+               ? 4
+               : 0;
 }
 
+/* string need not be terminated, a sequence cut short by string_len is read no further */
 static int is_valid_utf8(const char *string, size_t string_len)
 {
-    int len = 0;
     const char *string_end = string + string_len;
+    size_t word, len;
     while (string < string_end) {
-        if (!verify_utf8_sequence((const unsigned char *)string, &len)) {
+        if ((unsigned char)*string < 0x80) { /* ASCII runs are skipped a word at a time */
+            while ((size_t)(string_end - string) >= sizeof(word)) {
+                memcpy(&word, string, sizeof(word));
+                if (word & WORD_REPEAT(0x80)) {
+                    break;
+                }
+                string += sizeof(word);
+            }
+            while (string < string_end && (unsigned char)*string < 0x80) {
+                string++;
+            }
+            continue;
+        }
+        len = utf8_sequence_length((const unsigned char *)string, (size_t)(string_end - string));
+        if (len == 0) {
             return 0;
         }
         string += len;
@@ -286,6 +717,124 @@ static int is_decimal(const char *string, size_t length)
     return 1;
 }
 
+/* Indentation is skipped a word at a time, other whitespace a byte at a time */
+static const char *skip_whitespaces(const char *string, const char *end)
+{
+    size_t word;
+    while (string < end && isspace((unsigned char)*string)) {
+        string++;
+        while ((size_t)(end - string) >= sizeof(word)) {
+            memcpy(&word, string, sizeof(word));
+            if (word != WORD_REPEAT(' ')) {
+                break;
+            }
+            string += sizeof(word);
+        }
+    }
+    return string;
+}
+
+/* Length of the run of characters that need no unescaping, up to the first '\"', '\\' or control
+   character, or non-ASCII byte when ascii_only is set. Whole blocks free of those are skipped at
+   once and the rest is scanned bytewise. */
+static size_t scan_plain_chars(const char *string, const char *end, int ascii_only)
+{
+    const char *ptr = string;
+#if defined(PARSON_SSE2)
+    const __m128i quote = _mm_set1_epi8('\"'), backslash = _mm_set1_epi8('\\');
+    const __m128i max_control = _mm_set1_epi8(0x1F);
+    const int high_bits = ascii_only ? 0xFFFF : 0;
+    __m128i block, special;
+    while (end - ptr >= 16) {
+        block = _mm_loadu_si128((const __m128i *)(const void *)ptr);
+        special = _mm_or_si128(_mm_cmpeq_epi8(block, quote), _mm_cmpeq_epi8(block, backslash));
+        special = _mm_or_si128(special,
+                               _mm_cmpeq_epi8(_mm_min_epu8(block, max_control), block));
+        if ((_mm_movemask_epi8(special) | (_mm_movemask_epi8(block) & high_bits)) != 0) {
+            break;
+        }
+        ptr += 16;
+    }
+#elif defined(PARSON_NEON)
+    const uint8x16_t quote = vdupq_n_u8('\"'), backslash = vdupq_n_u8('\\');
+    const uint8x16_t control_limit = vdupq_n_u8(0x20);
+    const uint8x16_t high_bits = vdupq_n_u8(ascii_only ? 0x80 : 0);
+    uint8x16_t block, special;
+    uint64x2_t lanes;
+    while (end - ptr >= 16) {
+        block = vld1q_u8((const uint8_t *)ptr);
+        special = vorrq_u8(vceqq_u8(block, quote), vceqq_u8(block, backslash));
+        special = vorrq_u8(special, vcltq_u8(block, control_limit));
+        special = vorrq_u8(special, vtstq_u8(block, high_bits));
+        lanes = vreinterpretq_u64_u8(special);
+        if ((vgetq_lane_u64(lanes, 0) | vgetq_lane_u64(lanes, 1)) != 0) {
+            break;
+        }
+        ptr += 16;
+    }
+#else
+    const size_t high_bits = ascii_only ? WORD_REPEAT(0x80) : 0;
+    size_t word;
+    while ((size_t)(end - ptr) >= sizeof(word)) {
+        memcpy(&word, ptr, sizeof(word));
+        if (WORD_HAS_LESS(word ^ WORD_REPEAT('\"'), 1) ||
+            WORD_HAS_LESS(word ^ WORD_REPEAT('\\'), 1) || WORD_HAS_LESS(word, 0x20) ||
+            (word & high_bits) != 0) {
+            break;
+        }
+        ptr += sizeof(word);
+    }
+#endif
+    while (ptr < end && *ptr != '\"' && *ptr != '\\' && (unsigned char)*ptr >= 0x20 &&
+           (!ascii_only || (unsigned char)*ptr < 0x80)) {
+        ptr++;
+    }
+    return (size_t)(ptr - string);
+}
+
+/* Like scan_plain_chars, but the run also stops before invalid UTF-8. ASCII is skipped in blocks,
+   and text with multi-byte sequences is walked bytewise, each sequence being checked where it
+   starts, until ASCII runs long enough for blocks again. Unescaping thus validates a string
+   without a separate pass over it. */
+static size_t scan_valid_chars(const char *string, const char *end)
+{
+    const char *ptr = string;
+    size_t len = 0, ascii = 0;
+    for (;;) {
+        ptr += scan_plain_chars(ptr, end, 1);
+        for (ascii = 0; ptr < end && ascii < 16;) {
+            if (!((unsigned char)*ptr & 0x80)) {
+                if ((unsigned char)*ptr < 0x20 || *ptr == '\"' || *ptr == '\\') {
+                    return (size_t)(ptr - string);
+                }
+                ptr++;
+                ascii++;
+                continue;
+            }
+            len = utf8_sequence_length((const unsigned char *)ptr, (size_t)(end - ptr));
+            if (len == 0) {
+                return (size_t)(ptr - string);
+            }
+            ptr += len;
+            ascii = 0;
+        }
+        if (ptr == end) {
+            return (size_t)(ptr - string);
+        }
+    }
+}
+
+/* djb2 */
+static unsigned long hash_string(const char *string, size_t n)
+{
+    unsigned long hash = 5381;
+    size_t i;
+    for (i = 0; i < n; i++) {
+        hash = ((hash << 5) + hash) + (unsigned char)string[i];
+    }
+    return hash;
+}
+
 static void remove_comments(char *string, const char *start_token, const char *end_token)
 {
     int in_string = 0, escaped = 0;
@@ -323,17 +872,22 @@ static void remove_comments(char *string, const char *start_token, const char *e
 }
 
 /* JSON Object */
-static JSON_Object *json_object_init(JSON_Value *wrapping_value)
+static JSON_Object *json_object_init(JSON_Value *wrapping_value, JSON_Arena *arena)
 {
-    JSON_Object *new_obj = (JSON_Object *)parson_malloc(sizeof(JSON_Object));
+    JSON_Object *new_obj = (JSON_Object *)arena_malloc(arena, sizeof(JSON_Object));
     if (new_obj == NULL) {
         return NULL;
     }
     new_obj->wrapping_value = wrapping_value;
+    new_obj->arena = arena;
     new_obj->names = (char **)NULL;
     new_obj->values = (JSON_Value **)NULL;
+    new_obj->cells = (JSON_Object_Cell *)NULL;
+    new_obj->cell_count = 0;
     new_obj->capacity = 0;
     new_obj->count = 0;
+    new_obj->borrowed_names = 0;
+    new_obj->intern_table = parson_intern_table;
     return new_obj;
 }
 
@@ -348,30 +902,126 @@ static JSON_Status json_object_add(JSON_Object *object, const char *name, JSON_V
 static JSON_Status json_object_addn(JSON_Object *object, const char *name, size_t name_len,
                                     JSON_Value *value)
 {
-    size_t index = 0;
+    char *new_name = NULL;
+    unsigned long hash = 0;
     if (object == NULL || name == NULL || value == NULL) {
         return JSONFailure;
     }
-    if (json_object_getn_value(object, name, name_len) != NULL) {
+    hash = json_object_name_hash(object, name, name_len);
+    if (json_object_getn_index_hashed(object, name, name_len, hash) != OBJECT_INDEX_NOT_FOUND) {
+        return JSONFailure;
+    }
+    if (object->borrowed_names && json_object_own_names(object) == JSONFailure) {
+        return JSONFailure;
+    }
+    new_name = json_object_copy_name(object, name, name_len);
+    if (new_name == NULL) {
+        return JSONFailure;
+    }
+    if (json_object_append_hashed(object, new_name, value, hash) == JSONFailure) {
+        json_object_free_name(object, new_name);
         return JSONFailure;
     }
+    return JSONSuccess;
+}
+
+/* Appends name-value pair unless object already has name, which is hashed once for both.
+   Takes ownership of name on success. */
+static JSON_Status json_object_append_unique(JSON_Object *object, char *name, size_t name_len,
+                                             JSON_Value *value)
+{
+    unsigned long hash = json_object_name_hash(object, name, name_len);
+    if (json_object_getn_index_hashed(object, name, name_len, hash) != OBJECT_INDEX_NOT_FOUND) {
+        return JSONFailure;
+    }
+    return json_object_append_hashed(object, name, value, hash);
+}
+
+/* Appends name-value pair without checking for duplicates, takes ownership of name on success.
+   hash must be json_object_name_hash(object, name, strlen(name)). */
+static JSON_Status json_object_append_hashed(JSON_Object *object, char *name, JSON_Value *value,
+                                             unsigned long hash)
+{
+    size_t new_cell_count = 0;
     if (object->count >= object->capacity) {
         size_t new_capacity = MAX(object->capacity * 2, STARTING_CAPACITY);
         if (json_object_resize(object, new_capacity) == JSONFailure) {
             return JSONFailure;
         }
     }
-    index = object->count;
-    object->names[index] = parson_strndup(name, name_len);
-    if (object->names[index] == NULL) {
-        return JSONFailure;
+    if (object->count + 1 >= OBJECT_INDEX_THRESHOLD &&
+        (object->count + 1) * 2 > object->cell_count) {
+        new_cell_count = MAX(object->cell_count * 2, OBJECT_INDEX_THRESHOLD * 4);
+        if (json_object_index_rebuild(object, new_cell_count) == JSONFailure) {
+            return JSONFailure;
+        }
     }
     value->parent = json_object_get_wrapping_value(object);
-    object->values[index] = value;
+    object->names[object->count] = name;
+    object->values[object->count] = value;
+    if (object->cells != NULL) {
+        json_object_index_insert(object, object->count, hash);
+    }
     object->count++;
     return JSONSuccess;
 }
 
+/* Hash of name when object has a hash index or gets one with its next member, 0 otherwise */
+static unsigned long json_object_name_hash(const JSON_Object *object, const char *name,
+                                           size_t name_len)
+{
+    if (object->cells == NULL && object->count + 1 < OBJECT_INDEX_THRESHOLD) {
+        return 0;
+    }
+    return hash_string(name, name_len);
+}
+
+/* Copies names borrowed from an in-situ parsed input so that owned names can be mixed in */
+static JSON_Status json_object_own_names(JSON_Object *object)
+{
+    char **owned_names = NULL;
+    size_t i, j;
+    if (object->count == 0) {
+        object->borrowed_names = 0;
+        return JSONSuccess;
+    }
+    owned_names = (char **)arena_malloc(object->arena, object->capacity * sizeof(char *));
+    if (owned_names == NULL) {
+        return JSONFailure;
+    }
+    object->borrowed_names = 0; /* names are freed as owned ones from now on */
+    for (i = 0; i < object->count; i++) {
+        owned_names[i] = json_object_copy_name(object, object->names[i], strlen(object->names[i]));
+        if (owned_names[i] == NULL) {
+            for (j = 0; j < i; j++) {
+                json_object_free_name(object, owned_names[j]);
+            }
+            arena_free(object->arena, owned_names);
+            object->borrowed_names = 1;
+            return JSONFailure;
+        }
+    }
+    arena_free(object->arena, object->names);
+    object->names = owned_names;
+    return JSONSuccess;
+}
+
+/* Copies name for object, or shares it from the intern table of object */
+static char *json_object_copy_name(JSON_Object *object, const char *name, size_t name_len)
+{
+    if (object->intern_table != NULL) {
+        return intern_table_get(object->intern_table, name, name_len);
+    }
+    return arena_strndup(object->arena, name, name_len);
+}
+
+static void json_object_free_name(JSON_Object *object, char *name)
+{
+    if (!object->borrowed_names && object->intern_table == NULL) {
+        arena_free(object->arena, name);
+    }
+}
+
 static JSON_Status json_object_resize(JSON_Object *object, size_t new_capacity)
 {
     char **temp_names = NULL;
@@ -381,66 +1031,201 @@ static JSON_Status json_object_resize(JSON_Object *object, size_t new_capacity)
         (object->names != NULL && object->values == NULL) || new_capacity == 0) {
         return JSONFailure; /* Shouldn't happen */
     }
-    temp_names = (char **)parson_malloc(new_capacity * sizeof(char *));
+    temp_names = (char **)arena_malloc(object->arena, new_capacity * sizeof(char *));
     if (temp_names == NULL) {
         return JSONFailure;
     }
-    temp_values = (JSON_Value **)parson_malloc(new_capacity * sizeof(JSON_Value *));
+    temp_values = (JSON_Value **)arena_malloc(object->arena, new_capacity * sizeof(JSON_Value *));
     if (temp_values == NULL) {
-        parson_free(temp_names);
+        arena_free(object->arena, temp_names);
         return JSONFailure;
     }
     if (object->names != NULL && object->values != NULL && object->count > 0) {
         memcpy(temp_names, object->names, object->count * sizeof(char *));
         memcpy(temp_values, object->values, object->count * sizeof(JSON_Value *));
     }
-    parson_free(object->names);
-    parson_free(object->values);
+    arena_free(object->arena, object->names);
+    arena_free(object->arena, object->values);
     object->names = temp_names;
     object->values = temp_values;
     object->capacity = new_capacity;
     return JSONSuccess;
 }
 
-static JSON_Value *json_object_getn_value(const JSON_Object *object, const char *name,
-                                          size_t name_len)
+/* Trims object to its count, and its hash index to the size it would have grown to */
+static JSON_Status json_object_shrink(JSON_Object *object)
 {
-    size_t i, name_length;
-    for (i = 0; i < json_object_get_count(object); i++) {
-        name_length = strlen(object->names[i]);
-        if (name_length != name_len) {
-            continue;
+    size_t cell_count = OBJECT_INDEX_THRESHOLD * 4;
+    if (object->count == 0) {
+        arena_free(object->arena, object->names);
+        arena_free(object->arena, object->values);
+        object->names = NULL;
+        object->values = NULL;
+        object->capacity = 0;
+    } else if (object->count < object->capacity &&
+               json_object_resize(object, object->count) == JSONFailure) {
+        return JSONFailure;
+    }
+    if (object->cells == NULL) {
+        return JSONSuccess;
+    }
+    if (object->count + 1 < OBJECT_INDEX_THRESHOLD) {
+        arena_free(object->arena, object->cells);
+        object->cells = NULL;
+        object->cell_count = 0;
+        return JSONSuccess;
+    }
+    while (cell_count < object->count * 2) {
+        cell_count *= 2;
+    }
+    if (cell_count < object->cell_count) {
+        return json_object_index_rebuild(object, cell_count);
+    }
+    return JSONSuccess;
+}
+
+/* Replaces the hash index with an empty one of cell_count cells and indexes all names again,
+   reusing the hashes of the previous index when there is one */
+static JSON_Status json_object_index_rebuild(JSON_Object *object, size_t cell_count)
+{
+    JSON_Object_Cell *new_cells = NULL, *old_cells = object->cells;
+    size_t i, old_cell_count = object->cell_count;
+    new_cells =
+        (JSON_Object_Cell *)arena_malloc(object->arena, cell_count * sizeof(JSON_Object_Cell));
+    if (new_cells == NULL) {
+        return JSONFailure;
+    }
+    memset(new_cells, 0, cell_count * sizeof(JSON_Object_Cell));
+    object->cells = new_cells;
+    object->cell_count = cell_count;
+    if (old_cells != NULL) {
+        for (i = 0; i < old_cell_count; i++) {
+            if (old_cells[i].item != 0) {
+                json_object_index_insert(object, old_cells[i].item - 1, old_cells[i].hash);
+            }
         }
-        if (strncmp(object->names[i], name, name_len) == 0) {
-            return object->values[i];
+        arena_free(object->arena, old_cells);
+        return JSONSuccess;
+    }
+    for (i = 0; i < object->count; i++) {
+        json_object_index_insert(object, i,
+                                 hash_string(object->names[i], strlen(object->names[i])));
+    }
+    return JSONSuccess;
+}
+
+static void json_object_index_insert(JSON_Object *object, size_t item_index, unsigned long hash)
+{
+    size_t mask = object->cell_count - 1, cell = (size_t)hash & mask;
+    while (object->cells[cell].item != 0) {
+        cell = (cell + 1) & mask;
+    }
+    object->cells[cell].hash = hash;
+    object->cells[cell].item = item_index + 1;
+}
+
+/* Removes the cell pointing at item_index, shifting back the cells of the same probe run */
+static void json_object_index_remove(JSON_Object *object, size_t item_index)
+{
+    size_t mask = object->cell_count - 1, cell = 0, next = 0, home = 0;
+    const char *name = object->names[item_index];
+    cell = (size_t)hash_string(name, strlen(name)) & mask;
+    while (object->cells[cell].item != item_index + 1) {
+        cell = (cell + 1) & mask;
+    }
+    next = (cell + 1) & mask;
+    while (object->cells[next].item != 0) {
+        home = (size_t)object->cells[next].hash & mask;
+        /* move next into the hole unless its home lies cyclically in (cell, next] */
+        if ((next > cell && (home <= cell || home > next)) ||
+            (next < cell && (home <= cell && home > next))) {
+            object->cells[cell] = object->cells[next];
+            cell = next;
         }
+        next = (next + 1) & mask;
     }
-    return NULL;
+    object->cells[cell].item = 0;
+}
+
+static size_t json_object_getn_index(const JSON_Object *object, const char *name, size_t name_len)
+{
+    /* only the hash index needs the hash */
+    unsigned long hash = object->cells != NULL ? hash_string(name, name_len) : 0;
+    return json_object_getn_index_hashed(object, name, name_len, hash);
+}
+
+/* hash must be hash_string(name, name_len) */
+static size_t json_object_getn_index_hashed(const JSON_Object *object, const char *name,
+                                            size_t name_len, unsigned long hash)
+{
+    size_t i, mask, cell;
+    const char *item_name = NULL;
+    if (object->cells != NULL) {
+        mask = object->cell_count - 1;
+        for (cell = (size_t)hash & mask; object->cells[cell].item != 0; cell = (cell + 1) & mask) {
+            if (object->cells[cell].hash != hash) {
+                continue;
+            }
+            item_name = object->names[object->cells[cell].item - 1];
+            if ((item_name == name || strncmp(item_name, name, name_len) == 0) &&
+                item_name[name_len] == '\0') {
+                return object->cells[cell].item - 1;
+            }
+        }
+        return OBJECT_INDEX_NOT_FOUND;
+    }
+    for (i = 0; i < object->count; i++) {
+        item_name = object->names[i];
+        if ((item_name == name || strncmp(item_name, name, name_len) == 0) &&
+            item_name[name_len] == '\0') {
+            return i;
+        }
+    }
+    return OBJECT_INDEX_NOT_FOUND;
+}
+
+static JSON_Value *json_object_getn_value(const JSON_Object *object, const char *name,
+                                          size_t name_len)
+{
+    size_t index;
+    if (object == NULL) {
+        return NULL;
+    }
+    index = json_object_getn_index(object, name, name_len);
+    return index == OBJECT_INDEX_NOT_FOUND ? NULL : object->values[index];
 }
 
 static JSON_Status json_object_remove_internal(JSON_Object *object, const char *name,
                                                int free_value)
 {
     size_t i = 0, last_item_index = 0;
-    if (object == NULL || json_object_get_value(object, name) == NULL) {
+    const char *moved_name = NULL;
+    if (object == NULL || name == NULL) {
+        return JSONFailure;
+    }
+    i = json_object_getn_index(object, name, strlen(name));
+    if (i == OBJECT_INDEX_NOT_FOUND) {
         return JSONFailure;
     }
     last_item_index = json_object_get_count(object) - 1;
-    for (i = 0; i < json_object_get_count(object); i++) {
-        if (strcmp(object->names[i], name) == 0) {
-            parson_free(object->names[i]);
-            if (free_value) {
-                json_value_free(object->values[i]);
-            }
-            if (i != last_item_index) { /* Replace key value pair with one from the end */
-                object->names[i] = object->names[last_item_index];
-                object->values[i] = object->values[last_item_index];
-            }
-            object->count -= 1;
-            return JSONSuccess;
+    if (object->cells != NULL) {
+        json_object_index_remove(object, i);
+        if (i != last_item_index) { /* repoint the cell of the pair moved from the end */
+            json_object_index_remove(object, last_item_index);
+            moved_name = object->names[last_item_index];
+            json_object_index_insert(object, i, hash_string(moved_name, strlen(moved_name)));
         }
     }
-    return JSONFailure; /* No execution path should end here */
+    json_object_free_name(object, object->names[i]);
+    if (free_value) {
+        json_value_free(object->values[i]);
+    }
+    if (i != last_item_index) { /* Replace key value pair with one from the end */
+        object->names[i] = object->names[last_item_index];
+        object->values[i] = object->values[last_item_index];
+    }
+    object->count -= 1;
+    return JSONSuccess;
 }
 
 static JSON_Status json_object_dotremove_internal(JSON_Object *object, const char *name,
@@ -460,26 +1245,24 @@ static JSON_Status json_object_dotremove_internal(JSON_Object *object, const cha
     return json_object_dotremove_internal(temp_object, dot_pos + 1, free_value);
 }
 
+/* Members have already been freed by json_value_free */
 static void json_object_free(JSON_Object *object)
 {
-    size_t i;
-    for (i = 0; i < object->count; i++) {
-        parson_free(object->names[i]);
-        json_value_free(object->values[i]);
-    }
-    parson_free(object->names);
-    parson_free(object->values);
-    parson_free(object);
+    arena_free(object->arena, object->names);
+    arena_free(object->arena, object->values);
+    arena_free(object->arena, object->cells);
+    arena_free(object->arena, object);
 }
 
 /* JSON Array */
-static JSON_Array *json_array_init(JSON_Value *wrapping_value)
+static JSON_Array *json_array_init(JSON_Value *wrapping_value, JSON_Arena *arena)
 {
-    JSON_Array *new_array = (JSON_Array *)parson_malloc(sizeof(JSON_Array));
+    JSON_Array *new_array = (JSON_Array *)arena_malloc(arena, sizeof(JSON_Array));
     if (new_array == NULL) {
         return NULL;
     }
     new_array->wrapping_value = wrapping_value;
+    new_array->arena = arena;
     new_array->items = (JSON_Value **)NULL;
     new_array->capacity = 0;
     new_array->count = 0;
@@ -506,71 +1289,204 @@ static JSON_Status json_array_resize(JSON_Array *array, size_t new_capacity)
     if (new_capacity == 0) {
         return JSONFailure;
     }
-    new_items = (JSON_Value **)parson_malloc(new_capacity * sizeof(JSON_Value *));
+    new_items = (JSON_Value **)arena_malloc(array->arena, new_capacity * sizeof(JSON_Value *));
     if (new_items == NULL) {
         return JSONFailure;
     }
     if (array->items != NULL && array->count > 0) {
         memcpy(new_items, array->items, array->count * sizeof(JSON_Value *));
     }
-    parson_free(array->items);
+    arena_free(array->arena, array->items);
     array->items = new_items;
     array->capacity = new_capacity;
     return JSONSuccess;
 }
 
-static void json_array_free(JSON_Array *array)
+static JSON_Status json_array_shrink(JSON_Array *array)
 {
-    size_t i;
-    for (i = 0; i < array->count; i++) {
-        json_value_free(array->items[i]);
+    if (array->count == 0) {
+        arena_free(array->arena, array->items);
+        array->items = NULL;
+        array->capacity = 0;
+        return JSONSuccess;
+    }
+    if (array->count < array->capacity) {
+        return json_array_resize(array, array->count);
     }
-    parson_free(array->items);
-    parson_free(array);
+    return JSONSuccess;
+}
+
+/* Items have already been freed by json_value_free */
+static void json_array_free(JSON_Array *array)
+{
+    arena_free(array->arena, array->items);
+    arena_free(array->arena, array);
 }
 
 /* JSON Value */
-static JSON_Value *json_value_init_string_no_copy(char *string)
+static JSON_Value *json_value_alloc(JSON_Arena *arena, JSON_Value_Type type)
 {
-    JSON_Value *new_value = (JSON_Value *)parson_malloc(sizeof(JSON_Value));
+    JSON_Value *new_value = (JSON_Value *)arena_malloc(arena, sizeof(JSON_Value));
     if (!new_value) {
         return NULL;
     }
     new_value->parent = NULL;
-    new_value->type = JSONString;
-    new_value->value.string = string;
+    new_value->type = (unsigned char)type;
+    new_value->flags = arena != NULL ? VALUE_FLAG_ARENA : 0;
     return new_value;
 }
 
-/* Parser */
-static JSON_Status skip_quotes(const char **string)
+static JSON_Value_Value json_value_get_payload(const JSON_Value *value)
 {
-    if (**string != '\"') {
-        return JSONFailure;
+    JSON_Value_Value payload;
+    memcpy(&payload, value->payload, sizeof(payload));
+    return payload;
+}
+
+static void json_value_set_payload(JSON_Value *value, JSON_Value_Value payload)
+{
+    memcpy(value->payload, &payload, sizeof(payload));
+}
+
+static JSON_Value *json_value_init_object_arena(JSON_Arena *arena)
+{
+    JSON_Value *new_value = json_value_alloc(arena, JSONObject);
+    JSON_Value_Value payload;
+    if (!new_value) {
+        return NULL;
     }
-    SKIP_CHAR(string);
-    while (**string != '\"') {
-        if (**string == '\0') {
-            return JSONFailure;
-        } else if (**string == '\\') {
-            SKIP_CHAR(string);
-            if (**string == '\0') {
-                return JSONFailure;
-            }
-        }
-        SKIP_CHAR(string);
+    payload.object = json_object_init(new_value, arena);
+    if (!payload.object) {
+        arena_free(arena, new_value);
+        return NULL;
     }
-    SKIP_CHAR(string);
-    return JSONSuccess;
+    json_value_set_payload(new_value, payload);
+    return new_value;
 }
 
-static int parse_utf16(const char **unprocessed, char **processed)
+static JSON_Value *json_value_init_array_arena(JSON_Arena *arena)
+{
+    JSON_Value *new_value = json_value_alloc(arena, JSONArray);
+    JSON_Value_Value payload;
+    if (!new_value) {
+        return NULL;
+    }
+    payload.array = json_array_init(new_value, arena);
+    if (!payload.array) {
+        arena_free(arena, new_value);
+        return NULL;
+    }
+    json_value_set_payload(new_value, payload);
+    return new_value;
+}
+
+static JSON_Value *json_value_init_string_no_copy(JSON_Arena *arena, char *string)
+{
+    JSON_Value *new_value = json_value_alloc(arena, JSONString);
+    JSON_Value_Value payload;
+    if (!new_value) {
+        return NULL;
+    }
+    payload.string = string;
+    json_value_set_payload(new_value, payload);
+    return new_value;
+}
+
+/* Short strings are stored inline, saving an allocation */
+static JSON_Value *json_value_init_string_copy(JSON_Arena *arena, const char *string, size_t len)
+{
+    JSON_Value *new_value = NULL;
+    char *copy = NULL;
+    if (len < VALUE_PAYLOAD_SIZE) {
+        new_value = json_value_alloc(arena, JSONString);
+        if (!new_value) {
+            return NULL;
+        }
+        memcpy(new_value->payload, string, len);
+        new_value->payload[len] = '\0';
+        new_value->flags |= VALUE_FLAG_INLINE;
+        return new_value;
+    }
+    copy = arena_strndup(arena, string, len);
+    if (copy == NULL) {
+        return NULL;
+    }
+    new_value = json_value_init_string_no_copy(arena, copy);
+    if (new_value == NULL) {
+        arena_free(arena, copy);
+    }
+    return new_value;
+}
+
+static JSON_Value *json_value_init_number_arena(JSON_Arena *arena, double number)
+{
+    JSON_Value *new_value = NULL;
+    JSON_Value_Value payload;
+    if ((number * 0.0) != 0.0) { /* nan and inf test */
+        return NULL;
+    }
+    new_value = json_value_alloc(arena, JSONNumber);
+    if (new_value == NULL) {
+        return NULL;
+    }
+    payload.number = number;
+    json_value_set_payload(new_value, payload);
+    return new_value;
+}
+
+static JSON_Value *json_value_init_boolean_arena(JSON_Arena *arena, int boolean)
+{
+    JSON_Value *new_value = json_value_alloc(arena, JSONBoolean);
+    JSON_Value_Value payload;
+    if (!new_value) {
+        return NULL;
+    }
+    payload.boolean = boolean ? 1 : 0;
+    json_value_set_payload(new_value, payload);
+    return new_value;
+}
+
+static JSON_Value *json_value_init_null_arena(JSON_Arena *arena)
+{
+    return json_value_alloc(arena, JSONNull);
+}
+
+/* Parser */
+static JSON_Status skip_quotes(const char **string, const char *end)
+{
+    if (CURRENT_CHAR(string, end) != '\"') {
+        return JSONFailure;
+    }
+    SKIP_CHAR(string);
+    for (;;) {
+        *string += scan_plain_chars(*string, end, 0);
+        if (CURRENT_CHAR(string, end) == '\"') {
+            break;
+        } else if (CURRENT_CHAR(string, end) == '\0') {
+            return JSONFailure;
+        } else if (CURRENT_CHAR(string, end) == '\\') {
+            SKIP_CHAR(string);
+            if (CURRENT_CHAR(string, end) == '\0') {
+                return JSONFailure;
+            }
+        }
+        SKIP_CHAR(string);
+    }
+    SKIP_CHAR(string);
+    return JSONSuccess;
+}
+
+/* end bounds the escaped string, \u escapes running past it are rejected */
+static int parse_utf16(const char **unprocessed, char **processed, const char *end)
 {
     unsigned int cp, lead, trail;
     int parse_succeeded = 0;
     char *processed_ptr = *processed;
     const char *unprocessed_ptr = *unprocessed;
     unprocessed_ptr++; /* skips u */
+    if (end - unprocessed_ptr < 4) {
+        return JSONFailure;
+    }
     parse_succeeded = parse_utf16_hex(unprocessed_ptr, &cp);
     if (!parse_succeeded) {
         return JSONFailure;
@@ -588,9 +1504,8 @@ static int parse_utf16(const char **unprocessed, char **processed)
         processed_ptr += 2;
     } else if (cp >= 0xD800 && cp <= 0xDBFF) { /* lead surrogate (0xD800..0xDBFF) */
         lead = cp;
-        unprocessed_ptr +=
-            4; /* should always be within the buffer, otherwise previous sscanf would fail */
-        if (*unprocessed_ptr++ != '\\' || *unprocessed_ptr++ != 'u') {
+        unprocessed_ptr += 4;
+        if (end - unprocessed_ptr < 6 || *unprocessed_ptr++ != '\\' || *unprocessed_ptr++ != 'u') {
             return JSONFailure;
         }
         parse_succeeded = parse_utf16_hex(unprocessed_ptr, &trail);
@@ -613,68 +1528,115 @@ static int parse_utf16(const char **unprocessed, char **processed)
     return JSONSuccess;
 }
 
-/* Copies and processes passed string up to supplied length.
-Example: "\u006Corem ipsum" -> lorem ipsum */
-static char *process_string(const char *input, size_t len)
+/* Unescapes the sequence input points at, moving input and output past it. Writes up to 4 bytes. */
+static JSON_Status unescape_sequence(const char **input, char **output, const char *end)
+{
+    const char *input_ptr = *input + 1; /* skips \ */
+    char *output_ptr = *output;
+    if (input_ptr >= end) {
+        return JSONFailure;
+    }
+    switch (*input_ptr) {
+    case '\"':
+        *output_ptr = '\"';
+        break;
+    case '\\':
+        *output_ptr = '\\';
+        break;
+    case '/':
+        *output_ptr = '/';
+        break;
+    case 'b':
+        *output_ptr = '\b';
+        break;
+    case 'f':
+        *output_ptr = '\f';
+        break;
+    case 'n':
+        *output_ptr = '\n';
+        break;
+    case 'r':
+        *output_ptr = '\r';
+        break;
+    case 't':
+        *output_ptr = '\t';
+        break;
+    case 'u':
+        if (parse_utf16(&input_ptr, &output_ptr, end) == JSONFailure) {
+            return JSONFailure;
+        }
+        break;
+    default:
+        return JSONFailure;
+    }
+    *input = input_ptr + 1;
+    *output = output_ptr + 1;
+    return JSONSuccess;
+}
+
+/* Processes passed string up to supplied length into output, which needs len + 1 bytes.
+Example: "\u006Corem ipsum" -> lorem ipsum
+Output may point to the input, which it never outgrows, in which case the terminating '\0'
+lands at the latest on the closing quote. With a NULL output the string is only validated. */
+static JSON_Status unescape_string(const char *input, size_t len, char *output, size_t *output_len)
 {
     const char *input_ptr = input;
+    char scratch[4]; /* receives the characters when only validating */
+    char *output_ptr = output;
+    size_t run = 0;
+    while ((size_t)(input_ptr - input) < len) {
+        run = scan_valid_chars(input_ptr, input + len);
+        if (output != NULL && output_ptr != input_ptr) {
+            memmove(output_ptr, input_ptr, run);
+        }
+        input_ptr += run;
+        if (output == NULL) {
+            output_ptr = scratch;
+        } else {
+            output_ptr += run;
+        }
+        if ((size_t)(input_ptr - input) == len || *input_ptr == '\0') {
+            break;
+        }
+        if (*input_ptr != '\\') {
+            return JSONFailure; /* 0x00-0x19 are invalid characters for json string
+                                   (http://www.ietf.org/rfc/rfc4627.txt), as is invalid UTF-8 */
+        }
+        if (unescape_sequence(&input_ptr, &output_ptr, input + len) == JSONFailure) {
+            return JSONFailure;
+        }
+    }
+    if (output != NULL) {
+        *output_ptr = '\0';
+        if (output_len != NULL) {
+            *output_len = (size_t)(output_ptr - output);
+        }
+    }
+    return JSONSuccess;
+}
+
+/* Copies and processes passed string up to supplied length, in place when parsing in situ */
+static char *process_string(const char *input, size_t len, JSON_Parser *parser)
+{
     size_t initial_size = (len + 1) * sizeof(char);
     size_t final_size = 0;
-    char *output = NULL, *output_ptr = NULL, *resized_output = NULL;
-    output = (char *)parson_malloc(initial_size);
+    char *output = NULL, *resized_output = NULL;
+    if (parser->insitu) {
+        output = (char *)input;
+    } else {
+        output = (char *)arena_malloc(parser->arena, initial_size);
+    }
     if (output == NULL) {
         goto error;
     }
-    output_ptr = output;
-    while ((*input_ptr != '\0') && (size_t)(input_ptr - input) < len) {
-        if (*input_ptr == '\\') {
-            input_ptr++;
-            switch (*input_ptr) {
-            case '\"':
-                *output_ptr = '\"';
-                break;
-            case '\\':
-                *output_ptr = '\\';
-                break;
-            case '/':
-                *output_ptr = '/';
-                break;
-            case 'b':
-                *output_ptr = '\b';
-                break;
-            case 'f':
-                *output_ptr = '\f';
-                break;
-            case 'n':
-                *output_ptr = '\n';
-                break;
-            case 'r':
-                *output_ptr = '\r';
-                break;
-            case 't':
-                *output_ptr = '\t';
-                break;
-            case 'u':
-                if (parse_utf16(&input_ptr, &output_ptr) == JSONFailure) {
-                    goto error;
-                }
-                break;
-            default:
-                goto error;
-            }
-        } else if ((unsigned char)*input_ptr < 0x20) {
-            goto error; /* 0x00-0x19 are invalid characters for json string
-                           (http://www.ietf.org/rfc/rfc4627.txt) */
-        } else {
-            *output_ptr = *input_ptr;
-        }
-        output_ptr++;
-        input_ptr++;
+    if (unescape_string(input, len, output, &final_size) == JSONFailure) {
+        goto error;
     }
-    *output_ptr = '\0';
     /* resize to new length */
-    final_size = (size_t)(output_ptr - output) + 1;
-    /* todo: don't resize if final_size == initial_size */
+    final_size += 1;
+    if (parser->insitu || parser->arena != NULL || final_size == initial_size) {
+        return output; /* shrinking would only waste arena space */
+    }
     resized_output = (char *)parson_malloc(final_size);
     if (resized_output == NULL) {
         goto error;
@@ -683,40 +1645,189 @@ static char *process_string(const char *input, size_t len)
     parson_free(output);
     return resized_output;
 error:
-    parson_free(output);
+    if (!parser->insitu) {
+        arena_free(parser->arena, output);
+    }
     return NULL;
 }
 
 /* Return processed contents of a string between quotes and
    skips passed argument to a matching quote. */
-static char *get_quoted_string(const char **string)
+static char *get_quoted_string(const char **string, JSON_Parser *parser)
 {
     const char *string_start = *string;
     size_t string_len = 0;
-    JSON_Status status = skip_quotes(string);
+    JSON_Status status = skip_quotes(string, parser->end);
     if (status != JSONSuccess) {
         return NULL;
     }
     string_len = (size_t)(*string - string_start - 2); /* length without quotes */
-    return process_string(string_start + 1, string_len);
+    return process_string(string_start + 1, string_len, parser);
+}
+
+static void free_quoted_string(char *string, JSON_Parser *parser)
+{
+    if (!parser->insitu) {
+        arena_free(parser->arena, string);
+    }
+}
+
+/* Same as get_quoted_string, but shares the name from the intern table of object if it has one.
+   The name is freed with json_object_free_name. */
+static char *get_quoted_name(const char **string, JSON_Object *object, JSON_Parser *parser)
+{
+    const char *string_start = *string;
+    char name_buf[INTERN_NAME_BUF_SIZE];
+    char *name = NULL, *interned_name = NULL;
+    size_t name_len = 0;
+    if (object->intern_table == NULL || parser->insitu) {
+        return get_quoted_string(string, parser);
+    }
+    if (skip_quotes(string, parser->end) == JSONFailure) {
+        return NULL;
+    }
+    name_len = (size_t)(*string - string_start - 2); /* length without quotes */
+    if (scan_valid_chars(string_start + 1, *string - 1) == name_len) { /* nothing to unescape */
+        return intern_table_get(object->intern_table, string_start + 1, name_len);
+    }
+    if (name_len < INTERN_NAME_BUF_SIZE) {
+        if (unescape_string(string_start + 1, name_len, name_buf, &name_len) == JSONFailure) {
+            return NULL;
+        }
+        return intern_table_get(object->intern_table, name_buf, name_len);
+    }
+    name = process_string(string_start + 1, name_len, parser);
+    if (name == NULL) {
+        return NULL;
+    }
+    interned_name = intern_table_get(object->intern_table, name, strlen(name));
+    free_quoted_string(name, parser);
+    return interned_name;
 }
 
-static JSON_Value *parse_value(const char **string, size_t nesting)
+/* Reads the name of a member and the colon after it */
+static char *parse_member_name(const char **string, JSON_Object *object, JSON_Parser *parser)
 {
-    if (nesting > MAX_NESTING) {
+    char *name = get_quoted_name(string, object, parser);
+    if (name == NULL) {
+        return NULL;
+    }
+    SKIP_WHITESPACES(string, parser->end);
+    if (CURRENT_CHAR(string, parser->end) != ':') {
+        json_object_free_name(object, name);
         return NULL;
     }
-    SKIP_WHITESPACES(string);
-    switch (**string) {
+    SKIP_CHAR(string);
+    return name;
+}
+
+/* Pushes onto counts the number of members of every container in the input, in the order they
+   open. It is a single pass that only tells strings apart from structure, the input is validated
+   by parsing. Commas that do not follow a value are not counted, so runs of them cannot make the
+   parser reserve room before rejecting them, and containers nested deeper than the nesting limit
+   fail the pass, so that they cost no more than one count per level the parser accepts. */
+static JSON_Status count_members(const char *string, const char *end, JSON_Index_Stack *counts)
+{
+    JSON_Index_Stack open; /* index in counts of every open container */
+    JSON_Status status = JSONSuccess;
+    size_t *count = NULL;
+    char c = '\0', prev = '\0'; /* prev is the last character outside strings and whitespace */
+    index_stack_init(&open);
+    for (; string < end; string++) {
+        c = *string;
+        if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+            continue;
+        }
+        if (open.count == 0 && c != '{' && c != '[') {
+            break; /* past the root, or the root is not a container */
+        }
+        if (c == '}' || c == ']') {
+            open.count--;
+            if (open.count == 0) {
+                break;
+            }
+            prev = c;
+            continue;
+        }
+        if (open.count > 0) {
+            count = &counts->items[open.items[open.count - 1]];
+            if (c != ',') {
+                *count = MAX(*count, 1);
+            } else if (prev != '[' && prev != '{' && prev != ',' && prev != ':') {
+                (*count)++;
+            }
+        }
+        prev = c;
+        if (c == '{' || c == '[') {
+            if (open.count >= parson_nesting_limit || /* rejected by parse_value as well */
+                index_stack_push(&open, counts->count) == JSONFailure ||
+                index_stack_push(counts, 0) == JSONFailure) {
+                status = JSONFailure;
+                break;
+            }
+        } else if (c == '\"') {
+            for (string++; string < end; string++) {
+                string += scan_plain_chars(string, end, 0);
+                if (string == end || *string == '\"') {
+                    break;
+                }
+                if (*string == '\\' && string + 1 < end) {
+                    string++;
+                }
+            }
+            if (string == end) {
+                break;
+            }
+        }
+    }
+    index_stack_free(&open);
+    return status;
+}
+
+/* Number of members counted ahead for the container being opened, 0 when unknown. The count
+   comes from an unvalidated pass, so it is capped at what the rest of the input can hold, members
+   taking at least min_size characters with their comma or the closing bracket. */
+static size_t parse_member_count(JSON_Parser *parser, const char *string, size_t min_size)
+{
+    size_t container = parser->next_container++;
+    if (container < parser->member_counts->count) {
+        return MIN(parser->member_counts->items[container],
+                   (size_t)(parser->end - string) / min_size);
+    }
+    return 0;
+}
+
+/* Parses a scalar, or the opening bracket of a container, which is returned empty but with room
+   for its members */
+static JSON_Value *parse_value_start(const char **string, JSON_Parser *parser)
+{
+    JSON_Value *value = NULL;
+    JSON_Status status = JSONSuccess;
+    switch (CURRENT_CHAR(string, parser->end)) {
     case '{':
-        return parse_object_value(string, nesting + 1);
+        value = json_value_init_object_arena(parser->arena);
+        if (value == NULL) {
+            return NULL;
+        }
+        json_value_get_object(value)->borrowed_names = parser->insitu;
+        SKIP_CHAR(string);
+        status = json_object_reserve(json_value_get_object(value),
+                                     parse_member_count(parser, *string, SIZEOF_TOKEN("\"\":0,")));
+        break;
     case '[':
-        return parse_array_value(string, nesting + 1);
+        value = json_value_init_array_arena(parser->arena);
+        if (value == NULL) {
+            return NULL;
+        }
+        SKIP_CHAR(string);
+        status = json_array_reserve(json_value_get_array(value),
+                                    parse_member_count(parser, *string, SIZEOF_TOKEN("0,")));
+        break;
     case '\"':
-        return parse_string_value(string);
+        return parse_string_value(string, parser);
     case 'f':
     case 't':
-        return parse_boolean_value(string);
+        return parse_boolean_value(string, parser);
     case '-':
     case '0':
     case '1':
@@ -728,517 +1839,2473 @@ static JSON_Value *parse_value(const char **string, size_t nesting)
     case '7':
     case '8':
     case '9':
-        return parse_number_value(string);
+        return parse_number_value(string, parser);
     case 'n':
-        return parse_null_value(string);
+        return parse_null_value(string, parser);
     default:
         return NULL;
     }
+    if (status == JSONFailure) {
+        json_value_free(value);
+        return NULL;
+    }
+    return value;
 }
 
-static JSON_Value *parse_object_value(const char **string, size_t nesting)
+/* Adds value to container, under name when it is an object. Takes ownership of name. */
+static JSON_Status parse_attach(JSON_Value *container, char *name, JSON_Value *value)
 {
-    JSON_Value *output_value = NULL, *new_value = NULL;
-    JSON_Object *output_object = NULL;
-    char *new_key = NULL;
-    output_value = json_value_init_object();
-    if (output_value == NULL) {
-        return NULL;
-    }
-    if (**string != '{') {
-        json_value_free(output_value);
-        return NULL;
+    JSON_Object *object = json_value_get_object(container);
+    if (object == NULL) {
+        return json_array_add(json_value_get_array(container), value);
     }
-    output_object = json_value_get_object(output_value);
-    SKIP_CHAR(string);
-    SKIP_WHITESPACES(string);
-    if (**string == '}') { /* empty object */
-        SKIP_CHAR(string);
-        return output_value;
+    if (json_object_append_unique(object, name, strlen(name), value) == JSONFailure) {
+        json_object_free_name(object, name);
+        return JSONFailure;
     }
-    while (**string != '\0') {
-        new_key = get_quoted_string(string);
-        if (new_key == NULL) {
-            json_value_free(output_value);
-            return NULL;
+    return JSONSuccess;
+}
+
+/* Parses without recursion, so that the depth of the input does not matter to the C stack.
+   Containers are attached as soon as they are opened, and closing one goes back up to its
+   parent, so only the depth needs to be kept. */
+static JSON_Value *parse_value(const char **string, JSON_Parser *parser)
+{
+    JSON_Value *root = NULL, *container = NULL, *value = NULL;
+    JSON_Object *object = NULL; /* object of container, NULL when it is an array */
+    char *name = NULL;          /* name of the next member of object */
+    size_t depth = 0;
+    for (;;) {
+        SKIP_WHITESPACES(string, parser->end);
+        value = parse_value_start(string, parser);
+        if (value == NULL) {
+            goto error;
         }
-        SKIP_WHITESPACES(string);
-        if (**string != ':') {
-            parson_free(new_key);
-            json_value_free(output_value);
-            return NULL;
+        if (container == NULL) {
+            root = value;
+        } else if (parse_attach(container, name, value) == JSONFailure) {
+            name = NULL;
+            json_value_free(value);
+            goto error;
         }
-        SKIP_CHAR(string);
-        new_value = parse_value(string, nesting);
-        if (new_value == NULL) {
-            parson_free(new_key);
-            json_value_free(output_value);
-            return NULL;
+        name = NULL;
+        if (json_value_get_type(value) == JSONObject || json_value_get_type(value) == JSONArray) {
+            if (depth >= parson_nesting_limit) {
+                goto error;
+            }
+            depth++;
+            container = value;
+            object = json_value_get_object(container);
+            SKIP_WHITESPACES(string, parser->end);
+            if (CURRENT_CHAR(string, parser->end) != (object != NULL ? '}' : ']')) {
+                if (object != NULL) {
+                    name = parse_member_name(string, object, parser);
+                    if (name == NULL) {
+                        goto error;
+                    }
+                }
+                continue;
+            }
         }
-        if (json_object_add(output_object, new_key, new_value) == JSONFailure) {
-            parson_free(new_key);
-            json_value_free(new_value);
-            json_value_free(output_value);
-            return NULL;
+        /* value is complete, close the containers that end after it */
+        while (container != NULL) {
+            SKIP_WHITESPACES(string, parser->end);
+            if (CURRENT_CHAR(string, parser->end) == ',') {
+                SKIP_CHAR(string);
+                SKIP_WHITESPACES(string, parser->end);
+                if (object != NULL) {
+                    name = parse_member_name(string, object, parser);
+                    if (name == NULL) {
+                        goto error;
+                    }
+                }
+                break;
+            }
+            /* no trimming needed, containers were sized from the counted members */
+            if (CURRENT_CHAR(string, parser->end) != (object != NULL ? '}' : ']')) {
+                goto error;
+            }
+            SKIP_CHAR(string);
+            depth--;
+            container = depth > 0 ? json_value_get_parent(container) : NULL;
+            object = json_value_get_object(container);
         }
-        parson_free(new_key);
-        SKIP_WHITESPACES(string);
-        if (**string != ',') {
-            break;
+        if (container == NULL) {
+            return root;
         }
-        SKIP_CHAR(string);
-        SKIP_WHITESPACES(string);
     }
-    SKIP_WHITESPACES(string);
-    if (**string != '}' || /* Trim object after parsing is over */
-        json_object_resize(output_object, json_object_get_count(output_object)) == JSONFailure) {
-        json_value_free(output_value);
-        return NULL;
+error:
+    if (name != NULL) {
+        json_object_free_name(object, name);
     }
-    SKIP_CHAR(string);
-    return output_value;
+    json_value_free(root);
+    return NULL;
 }
 
-static JSON_Value *parse_array_value(const char **string, size_t nesting)
+static JSON_Value *parse_string_value(const char **string, JSON_Parser *parser)
 {
-    JSON_Value *output_value = NULL, *new_array_value = NULL;
-    JSON_Array *output_array = NULL;
-    output_value = json_value_init_array();
-    if (output_value == NULL) {
-        return NULL;
-    }
-    if (**string != '[') {
-        json_value_free(output_value);
+    JSON_Value *value = NULL;
+    const char *string_start = *string;
+    char short_string[VALUE_PAYLOAD_SIZE];
+    size_t string_len = 0;
+    char *new_string = NULL;
+    if (skip_quotes(string, parser->end) == JSONFailure) {
         return NULL;
     }
-    output_array = json_value_get_array(output_value);
-    SKIP_CHAR(string);
-    SKIP_WHITESPACES(string);
-    if (**string == ']') { /* empty array */
-        SKIP_CHAR(string);
-        return output_value;
-    }
-    while (**string != '\0') {
-        new_array_value = parse_value(string, nesting);
-        if (new_array_value == NULL) {
-            json_value_free(output_value);
-            return NULL;
-        }
-        if (json_array_add(output_array, new_array_value) == JSONFailure) {
-            json_value_free(new_array_value);
-            json_value_free(output_value);
+    string_len = (size_t)(*string - string_start - 2); /* length without quotes */
+    if (!parser->insitu && string_len < VALUE_PAYLOAD_SIZE) { /* unescapes short strings aside */
+        if (unescape_string(string_start + 1, string_len, short_string, &string_len) ==
+            JSONFailure) {
             return NULL;
         }
-        SKIP_WHITESPACES(string);
-        if (**string != ',') {
-            break;
-        }
-        SKIP_CHAR(string);
-        SKIP_WHITESPACES(string);
-    }
-    SKIP_WHITESPACES(string);
-    if (**string != ']' || /* Trim array after parsing is over */
-        json_array_resize(output_array, json_array_get_count(output_array)) == JSONFailure) {
-        json_value_free(output_value);
-        return NULL;
+        return json_value_init_string_copy(parser->arena, short_string, string_len);
     }
-    SKIP_CHAR(string);
-    return output_value;
-}
-
-static JSON_Value *parse_string_value(const char **string)
-{
-    JSON_Value *value = NULL;
-    char *new_string = get_quoted_string(string);
+    new_string = process_string(string_start + 1, string_len, parser);
     if (new_string == NULL) {
         return NULL;
     }
-    value = json_value_init_string_no_copy(new_string);
+    value = json_value_init_string_no_copy(parser->arena, new_string);
     if (value == NULL) {
-        parson_free(new_string);
+        free_quoted_string(new_string, parser);
         return NULL;
     }
+    if (parser->insitu) {
+        value->flags |= VALUE_FLAG_BORROWED;
+    }
     return value;
 }
 
-static JSON_Value *parse_boolean_value(const char **string)
+static JSON_Value *parse_boolean_value(const char **string, JSON_Parser *parser)
 {
-    size_t true_token_size = SIZEOF_TOKEN("true");
-    size_t false_token_size = SIZEOF_TOKEN("false");
-    if (strncmp("true", *string, true_token_size) == 0) {
-        *string += true_token_size;
-        return json_value_init_boolean(1);
-    } else if (strncmp("false", *string, false_token_size) == 0) {
-        *string += false_token_size;
-        return json_value_init_boolean(0);
+    if (skip_token(string, parser->end, "true", SIZEOF_TOKEN("true"))) {
+        return json_value_init_boolean_arena(parser->arena, 1);
+    } else if (skip_token(string, parser->end, "false", SIZEOF_TOKEN("false"))) {
+        return json_value_init_boolean_arena(parser->arena, 0);
     }
     return NULL;
 }
 
-static JSON_Value *parse_number_value(const char **string)
+static JSON_Value *parse_number_value(const char **string, JSON_Parser *parser)
 {
-    char *end;
     double number = 0;
-    errno = 0;
-    number = strtod(*string, &end);
-    if (errno || !is_decimal(*string, (size_t)(end - *string))) {
+    if (parse_number(string, parser->end, &number) == JSONFailure) {
         return NULL;
     }
-    *string = end;
-    return json_value_init_number(number);
+    return json_value_init_number_arena(parser->arena, number);
 }
 
-static JSON_Value *parse_null_value(const char **string)
+static JSON_Value *parse_null_value(const char **string, JSON_Parser *parser)
 {
-    size_t token_size = SIZEOF_TOKEN("null");
-    if (strncmp("null", *string, token_size) == 0) {
-        *string += token_size;
-        return json_value_init_null();
+    if (skip_token(string, parser->end, "null", SIZEOF_TOKEN("null"))) {
+        return json_value_init_null_arena(parser->arena);
     }
     return NULL;
 }
 
-/* Serialization */
-#define APPEND_STRING(str)                   \
-    do {                                     \
-        written = append_string(buf, (str)); \
-        if (written < 0) {                   \
-            return -1;                       \
-        }                                    \
-        if (buf != NULL) {                   \
-            buf += written;                  \
-        }                                    \
-        written_total += written;            \
-    } while (0)
-
-#define APPEND_INDENT(level)                   \
-    do {                                       \
-        written = append_indent(buf, (level)); \
-        if (written < 0) {                     \
-            return -1;                         \
-        }                                      \
-        if (buf != NULL) {                     \
-            buf += written;                    \
-        }                                      \
-        written_total += written;              \
-    } while (0)
-
-static int json_serialize_to_buffer_r(const JSON_Value *value, char *buf, int level, int is_pretty,
-                                      char *num_buf)
+/* Skips token and returns 1 if the input starts with it, returns 0 otherwise */
+static int skip_token(const char **string, const char *end, const char *token, size_t token_size)
 {
-    const char *key = NULL, *string = NULL;
-    JSON_Value *temp_value = NULL;
-    JSON_Array *array = NULL;
-    JSON_Object *object = NULL;
-    size_t i = 0, count = 0;
-    double num = 0.0;
-    int written = -1, written_total = 0;
+    if ((size_t)(end - *string) < token_size || strncmp(token, *string, token_size) != 0) {
+        return 0;
+    }
+    *string += token_size;
+    return 1;
+}
 
-    switch (json_value_get_type(value)) {
-    case JSONArray:
-        array = json_value_get_array(value);
-        count = json_array_get_count(array);
-        APPEND_STRING("[");
-        if (count > 0 && is_pretty) {
-            APPEND_STRING("\n");
+/* strtod does not take a length, so the number is copied out of the input and terminated.
+   Only numbers longer than NUM_BUF_SIZE need an allocation. */
+static JSON_Status parse_number(const char **string, const char *end, double *number)
+{
+    char num_buf[NUM_BUF_SIZE];
+    char *num_copy = num_buf, *num_copy_end = NULL;
+    const char *num_end = *string;
+    size_t num_len = 0;
+    if (parse_number_fast(string, end, number)) {
+        return JSONSuccess;
+    }
+    while (num_end < end && *num_end != '\0' && strchr("0123456789+-.eE", *num_end)) {
+        num_end++;
+    }
+    num_len = (size_t)(num_end - *string);
+    if (num_len >= NUM_BUF_SIZE) {
+        num_copy = parson_strndup(*string, num_len);
+        if (num_copy == NULL) {
+            return JSONFailure;
         }
-        for (i = 0; i < count; i++) {
-            if (is_pretty) {
-                APPEND_INDENT(level + 1);
-            }
-            temp_value = json_array_get_value(array, i);
-            written = json_serialize_to_buffer_r(temp_value, buf, level + 1, is_pretty, num_buf);
-            if (written < 0) {
-                return -1;
-            }
-            if (buf != NULL) {
-                buf += written;
-            }
-            written_total += written;
-            if (i < (count - 1)) {
-                APPEND_STRING(",");
-            }
-            if (is_pretty) {
-                APPEND_STRING("\n");
-            }
+    } else {
+        memcpy(num_buf, *string, num_len);
+        num_buf[num_len] = '\0';
+    }
+    errno = 0;
+    *number = strtod(num_copy, &num_copy_end);
+    num_len = (size_t)(num_copy_end - num_copy);
+    if (num_copy != num_buf) {
+        parson_free(num_copy);
+    }
+    if (errno || num_len == 0 || !is_decimal(*string, num_len)) {
+        return JSONFailure;
+    }
+    *string += num_len;
+    return JSONSuccess;
+}
+
+/* Parses -?(0|[1-9][0-9]*)(.[0-9]+)? with at most 15 significant digits and 22 decimals, returns
+   0 without moving string for anything else. Both the digits and the power of ten are exact
+   doubles then, so a single division is correctly rounded and matches strtod (Clinger 1990). */
+static int parse_number_fast(const char **string, const char *end, double *number)
+{
+    static const double powers_of_ten[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    const char *ptr = *string;
+    double mantissa = 0;
+    int negative = 0, digit_count = 0, decimal_count = 0;
+    if (ptr < end && *ptr == '-') {
+        negative = 1;
+        ptr++;
+    }
+    if (ptr >= end || !isdigit((unsigned char)*ptr)) {
+        return 0;
+    }
+    if (*ptr == '0') { /* a leading zero is followed by '.' or nothing, checked below */
+        ptr++;
+    } else {
+        while (ptr < end && isdigit((unsigned char)*ptr)) {
+            mantissa = mantissa * 10 + (*ptr++ - '0');
+            digit_count++;
         }
-        if (count > 0 && is_pretty) {
-            APPEND_INDENT(level);
+    }
+    if (ptr < end && *ptr == '.') {
+        ptr++;
+        if (ptr >= end || !isdigit((unsigned char)*ptr)) {
+            return 0;
         }
-        APPEND_STRING("]");
-        return written_total;
-    case JSONObject:
-        object = json_value_get_object(value);
-        count = json_object_get_count(object);
-        APPEND_STRING("{");
-        if (count > 0 && is_pretty) {
-            APPEND_STRING("\n");
+        while (ptr < end && isdigit((unsigned char)*ptr)) {
+            mantissa = mantissa * 10 + (*ptr - '0');
+            digit_count += digit_count > 0 || *ptr != '0'; /* leading zeros are not significant */
+            decimal_count++;
+            ptr++;
         }
-        for (i = 0; i < count; i++) {
-            key = json_object_get_name(object, i);
-            if (key == NULL) {
-                return -1;
-            }
-            if (is_pretty) {
-                APPEND_INDENT(level + 1);
-            }
-            written = json_serialize_string(key, buf);
-            if (written < 0) {
-                return -1;
-            }
-            if (buf != NULL) {
-                buf += written;
+    }
+    if (digit_count > 15 || decimal_count > 22 ||
+        (ptr < end && *ptr != '\0' && strchr("0123456789+-.eE", *ptr))) {
+        return 0;
+    }
+    mantissa /= powers_of_ten[decimal_count];
+    *number = negative ? -mantissa : mantissa;
+    *string = ptr;
+    return 1;
+}
+
+/* Event parser */
+static JSON_Status emit_event(JSON_Event_Parser *parser, JSON_Event *event)
+{
+    if (!parser->handler(event, parser->context)) {
+        parser->stopped = 1;
+        return JSONFailure;
+    }
+    return JSONSuccess;
+}
+
+/* Reports the name of a member and skips the colon after it */
+static JSON_Status parse_event_key(const char **string, size_t depth, JSON_Event_Parser *parser)
+{
+    JSON_Event event;
+    const char *string_start = *string;
+    if (skip_quotes(string, parser->end) == JSONFailure ||
+        unescape_string(string_start + 1, (size_t)(*string - string_start - 2), NULL, NULL) ==
+            JSONFailure) {
+        return JSONFailure;
+    }
+    memset(&event, 0, sizeof(JSON_Event));
+    event.type = JSONEventKey;
+    event.depth = depth;
+    event.string = string_start + 1;
+    event.length = (size_t)(*string - string_start - 2);
+    if (emit_event(parser, &event) == JSONFailure) {
+        return JSONFailure;
+    }
+    SKIP_WHITESPACES(string, parser->end);
+    if (CURRENT_CHAR(string, parser->end) != ':') {
+        return JSONFailure;
+    }
+    SKIP_CHAR(string);
+    return JSONSuccess;
+}
+
+/* Reports a value that is not a container */
+static JSON_Status parse_event_scalar(const char **string, size_t depth, JSON_Event_Parser *parser)
+{
+    JSON_Event event;
+    const char *string_start = NULL;
+    memset(&event, 0, sizeof(JSON_Event));
+    event.depth = depth;
+    switch (CURRENT_CHAR(string, parser->end)) {
+    case '\"':
+        string_start = *string;
+        if (skip_quotes(string, parser->end) == JSONFailure ||
+            unescape_string(string_start + 1, (size_t)(*string - string_start - 2), NULL, NULL) ==
+                JSONFailure) {
+            return JSONFailure;
+        }
+        event.type = JSONEventString;
+        event.string = string_start + 1;
+        event.length = (size_t)(*string - string_start - 2);
+        return emit_event(parser, &event);
+    case 'f':
+    case 't':
+        event.type = JSONEventBoolean;
+        if (skip_token(string, parser->end, "true", SIZEOF_TOKEN("true"))) {
+            event.boolean = 1;
+        } else if (!skip_token(string, parser->end, "false", SIZEOF_TOKEN("false"))) {
+            return JSONFailure;
+        }
+        return emit_event(parser, &event);
+    case 'n':
+        event.type = JSONEventNull;
+        if (!skip_token(string, parser->end, "null", SIZEOF_TOKEN("null"))) {
+            return JSONFailure;
+        }
+        return emit_event(parser, &event);
+    case '-':
+    case '0':
+    case '1':
+    case '2':
+    case '3':
+    case '4':
+    case '5':
+    case '6':
+    case '7':
+    case '8':
+    case '9':
+        event.type = JSONEventNumber;
+        string_start = *string;
+        if (parse_number(string, parser->end, &event.number) == JSONFailure ||
+            (event.number * 0.0) != 0.0) { /* nan and inf, as in json_value_init_number */
+            return JSONFailure;
+        }
+        event.string = string_start;
+        event.length = (size_t)(*string - string_start);
+        return emit_event(parser, &event);
+    default:
+        return JSONFailure;
+    }
+}
+
+/* Walks one value with the same tokenizer as parse_value, reporting it instead of building it.
+   Like parse_value it does not recurse: whether every open container is an object is kept, and
+   their number is the depth. */
+static JSON_Status parse_events(const char **string, JSON_Event_Parser *parser)
+{
+    JSON_Index_Stack open; /* 1 for every open object, 0 for every open array */
+    JSON_Event event;
+    JSON_Status status = JSONFailure;
+    int is_object = 0;
+    index_stack_init(&open);
+    memset(&event, 0, sizeof(JSON_Event));
+    for (;;) {
+        SKIP_WHITESPACES(string, parser->end);
+        if (CURRENT_CHAR(string, parser->end) == '{' || CURRENT_CHAR(string, parser->end) == '[') {
+            if (open.count >= parson_nesting_limit) {
+                goto end;
             }
-            written_total += written;
-            APPEND_STRING(":");
-            if (is_pretty) {
-                APPEND_STRING(" ");
+            is_object = CURRENT_CHAR(string, parser->end) == '{';
+            event.type = is_object ? JSONEventStartObject : JSONEventStartArray;
+            event.depth = open.count;
+            event.string = *string;
+            event.length = 1;
+            if (emit_event(parser, &event) == JSONFailure ||
+                index_stack_push(&open, (size_t)is_object) == JSONFailure) {
+                goto end;
             }
-            temp_value = json_object_get_value(object, key);
-            written = json_serialize_to_buffer_r(temp_value, buf, level + 1, is_pretty, num_buf);
-            if (written < 0) {
-                return -1;
+            SKIP_CHAR(string);
+            SKIP_WHITESPACES(string, parser->end);
+            if (CURRENT_CHAR(string, parser->end) != (is_object ? '}' : ']')) {
+                if (is_object && parse_event_key(string, open.count, parser) == JSONFailure) {
+                    goto end;
+                }
+                continue;
             }
-            if (buf != NULL) {
-                buf += written;
+        } else if (parse_event_scalar(string, open.count, parser) == JSONFailure) {
+            goto end;
+        }
+        /* value is complete, close the containers that end after it */
+        while (open.count > 0) {
+            is_object = open.items[open.count - 1] != 0;
+            SKIP_WHITESPACES(string, parser->end);
+            if (CURRENT_CHAR(string, parser->end) == ',') {
+                SKIP_CHAR(string);
+                SKIP_WHITESPACES(string, parser->end);
+                if (is_object && parse_event_key(string, open.count, parser) == JSONFailure) {
+                    goto end;
+                }
+                break;
             }
-            written_total += written;
-            if (i < (count - 1)) {
-                APPEND_STRING(",");
+            if (CURRENT_CHAR(string, parser->end) != (is_object ? '}' : ']')) {
+                goto end;
             }
-            if (is_pretty) {
-                APPEND_STRING("\n");
+            open.count--;
+            event.type = is_object ? JSONEventEndObject : JSONEventEndArray;
+            event.depth = open.count;
+            event.string = *string;
+            event.length = 1;
+            SKIP_CHAR(string);
+            if (emit_event(parser, &event) == JSONFailure) {
+                goto end;
             }
         }
-        if (count > 0 && is_pretty) {
-            APPEND_INDENT(level);
+        if (open.count == 0) {
+            status = JSONSuccess;
+            goto end;
         }
-        APPEND_STRING("}");
-        return written_total;
-    case JSONString:
-        string = json_value_get_string(value);
-        if (string == NULL) {
-            return -1;
+    }
+end:
+    index_stack_free(&open);
+    return status;
+}
+
+/* Incremental parser */
+/* Keeps a terminating '\0' after the token, which unescape_string needs room for */
+static JSON_Status stream_token_append(JSON_Stream *stream, const char *chars, size_t n)
+{
+    char *new_token = NULL;
+    size_t new_capacity = 0;
+    if (stream->token_length + n + 1 > stream->token_capacity) {
+        new_capacity = MAX(stream->token_capacity * 2, STREAM_TOKEN_MIN_CAPACITY);
+        while (new_capacity < stream->token_length + n + 1) {
+            new_capacity *= 2;
         }
-        written = json_serialize_string(string, buf);
-        if (written < 0) {
-            return -1;
+        new_token = (char *)parson_malloc(new_capacity);
+        if (new_token == NULL) {
+            return JSONFailure;
         }
-        if (buf != NULL) {
-            buf += written;
+        if (stream->token_length > 0) {
+            memcpy(new_token, stream->token, stream->token_length);
         }
-        written_total += written;
-        return written_total;
-    case JSONBoolean:
-        if (json_value_get_boolean(value)) {
-            APPEND_STRING("true");
-        } else {
-            APPEND_STRING("false");
+        parson_free(stream->token);
+        stream->token = new_token;
+        stream->token_capacity = new_capacity;
+    }
+    memcpy(stream->token + stream->token_length, chars, n);
+    stream->token_length += n;
+    stream->token[stream->token_length] = '\0';
+    return JSONSuccess;
+}
+
+/* Drops the partial value, the stream stays in error until it is reset */
+static void stream_fail(JSON_Stream *stream)
+{
+    JSON_Stream_Frame *frame = NULL;
+    while (stream->frame_count > 0) {
+        frame = &stream->frames[--stream->frame_count];
+        if (frame->name != NULL) {
+            json_object_free_name(json_value_get_object(frame->value), frame->name);
         }
-        return written_total;
-    case JSONNumber:
-        num = json_value_get_number(value);
-        if (buf != NULL) {
-            num_buf = buf;
+    }
+    json_value_free(stream->root);
+    stream->root = NULL;
+    stream->token_length = 0;
+    stream->escaped = 0;
+    stream->state = STREAM_ERROR;
+}
+
+static void stream_value_done(JSON_Stream *stream)
+{
+    stream->state = stream->frame_count == 0 ? STREAM_COMPLETE : STREAM_COMMA_OR_END;
+}
+
+/* Adds value to the innermost container, or makes it the root, and opens it if it is one */
+static JSON_Status stream_attach(JSON_Stream *stream, JSON_Value *value)
+{
+    JSON_Stream_Frame *frame = NULL, *new_frames = NULL;
+    JSON_Object *object = NULL;
+    size_t new_capacity = 0;
+    if (value == NULL) {
+        return JSONFailure;
+    }
+    if (stream->frame_count == 0) {
+        stream->root = value;
+    } else {
+        frame = &stream->frames[stream->frame_count - 1];
+        if (json_value_get_type(frame->value) == JSONObject) {
+            object = json_value_get_object(frame->value);
+            if (json_object_append_unique(object, frame->name, strlen(frame->name), value) ==
+                JSONFailure) {
+                json_value_free(value);
+                return JSONFailure;
+            }
+            frame->name = NULL;
+        } else if (json_array_add(json_value_get_array(frame->value), value) == JSONFailure) {
+            json_value_free(value);
+            return JSONFailure;
         }
-        written = sprintf(num_buf, FLOAT_FORMAT, num);
-        if (written < 0) {
-            return -1;
+    }
+    if (json_value_get_type(value) != JSONObject && json_value_get_type(value) != JSONArray) {
+        stream_value_done(stream);
+        return JSONSuccess;
+    }
+    if (stream->frame_count >= parson_nesting_limit) {
+        return JSONFailure;
+    }
+    if (stream->frame_count == stream->frame_capacity) {
+        new_capacity = MAX(stream->frame_capacity * 2, STARTING_CAPACITY);
+        new_frames = (JSON_Stream_Frame *)parson_malloc(new_capacity * sizeof(JSON_Stream_Frame));
+        if (new_frames == NULL) {
+            return JSONFailure;
         }
-        if (buf != NULL) {
-            buf += written;
+        if (stream->frame_count > 0) {
+            memcpy(new_frames, stream->frames, stream->frame_count * sizeof(JSON_Stream_Frame));
         }
-        written_total += written;
-        return written_total;
-    case JSONNull:
-        APPEND_STRING("null");
-        return written_total;
-    case JSONError:
-        return -1;
+        parson_free(stream->frames);
+        stream->frames = new_frames;
+        stream->frame_capacity = new_capacity;
+    }
+    frame = &stream->frames[stream->frame_count++];
+    frame->value = value;
+    frame->name = NULL;
+    stream->state = json_value_get_type(value) == JSONObject ? STREAM_NAME_OR_END :
+                                                                STREAM_VALUE_OR_END;
+    return JSONSuccess;
+}
+
+/* Closes the innermost container, trimming it like the parser does */
+static JSON_Status stream_close(JSON_Stream *stream)
+{
+    JSON_Value *value = stream->frames[--stream->frame_count].value;
+    JSON_Object *object = json_value_get_object(value);
+    JSON_Array *array = json_value_get_array(value);
+    if ((object != NULL && json_object_shrink(object) == JSONFailure) ||
+        (array != NULL && json_array_shrink(array) == JSONFailure)) {
+        return JSONFailure;
+    }
+    stream_value_done(stream);
+    return JSONSuccess;
+}
+
+/* Unescapes the string token in place, then keeps it as the pending name or attaches it */
+static JSON_Status stream_finish_string(JSON_Stream *stream)
+{
+    JSON_Stream_Frame *frame = NULL;
+    size_t length = 0;
+    if (unescape_string(stream->token, stream->token_length, stream->token, &length) ==
+        JSONFailure) {
+        return JSONFailure;
+    }
+    stream->token_length = 0;
+    if (!stream->token_is_name) {
+        return stream_attach(stream, json_value_init_string_copy(NULL, stream->token, length));
+    }
+    frame = &stream->frames[stream->frame_count - 1];
+    frame->name = json_object_copy_name(json_value_get_object(frame->value), stream->token,
+                                        length);
+    if (frame->name == NULL) {
+        return JSONFailure;
+    }
+    stream->state = STREAM_COLON;
+    return JSONSuccess;
+}
+
+static JSON_Status stream_finish_number(JSON_Stream *stream)
+{
+    const char *ptr = stream->token;
+    double number = 0;
+    if (parse_number(&ptr, stream->token + stream->token_length, &number) == JSONFailure ||
+        ptr != stream->token + stream->token_length) {
+        return JSONFailure;
+    }
+    stream->token_length = 0;
+    return stream_attach(stream, json_value_init_number_arena(NULL, number));
+}
+
+static JSON_Status stream_start_value(JSON_Stream *stream, char c)
+{
+    switch (c) {
+    case '{':
+        return stream_attach(stream, json_value_init_object_arena(NULL));
+    case '[':
+        return stream_attach(stream, json_value_init_array_arena(NULL));
+    case '\"':
+        stream->token_is_name = 0;
+        stream->state = STREAM_STRING;
+        return JSONSuccess;
+    case 't':
+    case 'f':
+    case 'n':
+        stream->state = STREAM_LITERAL;
+        return stream_token_append(stream, &c, 1);
+    case '-':
+    case '0':
+    case '1':
+    case '2':
+    case '3':
+    case '4':
+    case '5':
+    case '6':
+    case '7':
+    case '8':
+    case '9':
+        stream->state = STREAM_NUMBER;
+        return stream_token_append(stream, &c, 1);
     default:
-        return -1;
+        return JSONFailure;
     }
 }
 
-static int json_serialize_string(const char *string, char *buf)
+/* Reads one character, or a run of plain string characters, and returns where to go on.
+   Failures leave the stream in STREAM_ERROR. */
+static const char *stream_step(JSON_Stream *stream, const char *ptr, const char *end)
 {
-    size_t i = 0, len = strlen(string);
-    char c = '\0';
-    int written = -1, written_total = 0;
-    APPEND_STRING("\"");
-    for (i = 0; i < len; i++) {
-        c = string[i];
-        switch (c) {
-        case '\"':
-            APPEND_STRING("\\\"");
-            break;
-        case '\\':
-            APPEND_STRING("\\\\");
-            break;
-        case '/':
-            APPEND_STRING("\\/");
-            break; /* to make json embeddable in xml\/html */
-        case '\b':
-            APPEND_STRING("\\b");
-            break;
-        case '\f':
-            APPEND_STRING("\\f");
-            break;
-        case '\n':
-            APPEND_STRING("\\n");
-            break;
-        case '\r':
-            APPEND_STRING("\\r");
-            break;
-        case '\t':
-            APPEND_STRING("\\t");
-            break;
-        case '\x00':
-            APPEND_STRING("\\u0000");
-            break;
-        case '\x01':
-            APPEND_STRING("\\u0001");
-            break;
-        case '\x02':
-            APPEND_STRING("\\u0002");
-            break;
-        case '\x03':
-            APPEND_STRING("\\u0003");
-            break;
-        case '\x04':
-            APPEND_STRING("\\u0004");
-            break;
-        case '\x05':
-            APPEND_STRING("\\u0005");
-            break;
-        case '\x06':
-            APPEND_STRING("\\u0006");
-            break;
-        case '\x07':
-            APPEND_STRING("\\u0007");
-            break;
-        /* '\x08' duplicate: '\b' */
-        /* '\x09' duplicate: '\t' */
-        /* '\x0a' duplicate: '\n' */
-        case '\x0b':
-            APPEND_STRING("\\u000b");
-            break;
-        /* '\x0c' duplicate: '\f' */
-        /* '\x0d' duplicate: '\r' */
-        case '\x0e':
-            APPEND_STRING("\\u000e");
-            break;
-        case '\x0f':
-            APPEND_STRING("\\u000f");
-            break;
-        case '\x10':
-            APPEND_STRING("\\u0010");
-            break;
-        case '\x11':
-            APPEND_STRING("\\u0011");
-            break;
-        case '\x12':
-            APPEND_STRING("\\u0012");
-            break;
-        case '\x13':
-            APPEND_STRING("\\u0013");
-            break;
-        case '\x14':
-            APPEND_STRING("\\u0014");
-            break;
-        case '\x15':
-            APPEND_STRING("\\u0015");
-            break;
-        case '\x16':
-            APPEND_STRING("\\u0016");
+    JSON_Status status = JSONSuccess;
+    JSON_Object *object = NULL;
+    const char *literal = NULL;
+    size_t run = 0;
+    char c = *ptr;
+    switch (stream->state) {
+    case STREAM_STRING:
+        if ((unsigned char)c < 0x20) { /* '\0' would end the token before unescaping sees it */
+            status = JSONFailure;
             break;
-        case '\x17':
-            APPEND_STRING("\\u0017");
+        }
+        if (stream->escaped) { /* the sequence is checked when the string is unescaped */
+            stream->escaped = 0;
+            status = stream_token_append(stream, ptr, 1);
+            ptr++;
             break;
-        case '\x18':
-            APPEND_STRING("\\u0018");
+        }
+        run = scan_plain_chars(ptr, end, 0);
+        if (run == 0 && c == '\"') {
+            status = stream_finish_string(stream);
+            ptr++;
             break;
-        case '\x19':
-            APPEND_STRING("\\u0019");
+        }
+        if (run == 0) { /* a backslash */
+            stream->escaped = 1;
+            run = 1;
+        }
+        status = stream_token_append(stream, ptr, run);
+        ptr += run;
+        break;
+    case STREAM_NUMBER:
+        if (c != '\0' && strchr("0123456789+-.eE", c) != NULL) {
+            status = stream_token_append(stream, ptr, 1);
+            ptr++;
+        } else { /* c follows the number and is read again in the next state */
+            status = stream_finish_number(stream);
+        }
+        break;
+    case STREAM_LITERAL:
+        literal = stream->token[0] == 't' ? "true" : stream->token[0] == 'f' ? "false" : "null";
+        if (c != literal[stream->token_length]) {
+            status = JSONFailure;
             break;
-        case '\x1a':
-            APPEND_STRING("\\u001a");
+        }
+        status = stream_token_append(stream, ptr, 1);
+        ptr++;
+        if (status == JSONSuccess && literal[stream->token_length] == '\0') {
+            stream->token_length = 0;
+            status = stream_attach(stream, literal[0] == 'n' ? json_value_init_null_arena(NULL) :
+                                           json_value_init_boolean_arena(NULL, literal[0] == 't'));
+        }
+        break;
+    default:
+        if (isspace((unsigned char)c)) {
+            ptr++;
             break;
-        case '\x1b':
-            APPEND_STRING("\\u001b");
+        }
+        ptr++;
+        switch (stream->state) {
+        case STREAM_VALUE_OR_END:
+            status = c == ']' ? stream_close(stream) : stream_start_value(stream, c);
             break;
-        case '\x1c':
-            APPEND_STRING("\\u001c");
+        case STREAM_VALUE:
+            status = stream_start_value(stream, c);
             break;
-        case '\x1d':
-            APPEND_STRING("\\u001d");
+        case STREAM_NAME_OR_END:
+            if (c == '}') {
+                status = stream_close(stream);
+                break;
+            }
+            /* fall through */
+        case STREAM_NAME:
+            stream->token_is_name = 1;
+            stream->state = STREAM_STRING;
+            status = c == '\"' ? JSONSuccess : JSONFailure;
             break;
-        case '\x1e':
-            APPEND_STRING("\\u001e");
+        case STREAM_COLON:
+            stream->state = STREAM_VALUE;
+            status = c == ':' ? JSONSuccess : JSONFailure;
             break;
-        case '\x1f':
-            APPEND_STRING("\\u001f");
+        case STREAM_COMMA_OR_END:
+            object = json_value_get_object(stream->frames[stream->frame_count - 1].value);
+            if (c == ',') {
+                stream->state = object != NULL ? STREAM_NAME : STREAM_VALUE;
+            } else if (c != (object != NULL ? '}' : ']')) {
+                status = JSONFailure;
+            } else {
+                status = stream_close(stream);
+            }
             break;
         default:
-            if (buf != NULL) {
-                buf[0] = c;
-                buf += 1;
-            }
-            written_total += 1;
+            status = JSONFailure;
             break;
         }
+        break;
+    }
+    if (status == JSONFailure) {
+        stream_fail(stream);
+    }
+    return ptr;
+}
+
+/* Lazy parser */
+static JSON_Status tape_push(JSON_Tape *tape, size_t start)
+{
+    JSON_Tape_Entry *new_entries = NULL;
+    size_t new_capacity = 0;
+    if (tape->count >= UINT_MAX) {
+        return JSONFailure; /* indices are kept in an unsigned int by unparsed containers */
+    }
+    if (tape->count >= tape->capacity) {
+        new_capacity = MAX(tape->capacity * 2, STARTING_CAPACITY);
+        new_entries = (JSON_Tape_Entry *)parson_malloc(new_capacity * sizeof(JSON_Tape_Entry));
+        if (new_entries == NULL) {
+            return JSONFailure;
+        }
+        if (tape->entries != NULL) {
+            memcpy(new_entries, tape->entries, tape->count * sizeof(JSON_Tape_Entry));
+            parson_free(tape->entries);
+        }
+        tape->entries = new_entries;
+        tape->capacity = new_capacity;
+    }
+    tape->entries[tape->count].start = start;
+    tape->entries[tape->count].end = 0;
+    tape->entries[tape->count].count = 0;
+    tape->entries[tape->count].next = 0;
+    tape->count++;
+    return JSONSuccess;
+}
+
+/* Frees the tape once no unparsed container points at it anymore */
+static void tape_release(JSON_Tape *tape)
+{
+    tape->refs--;
+    if (tape->refs > 0) {
+        return;
+    }
+    parson_free(tape->entries);
+    parson_free(tape->text);
+    parson_free(tape);
+}
+
+/* Skips a string token, checking its escapes and UTF-8 without unescaping it */
+static JSON_Status tape_skip_string(const char **string, const char *end)
+{
+    const char *string_start = *string;
+    if (skip_quotes(string, end) == JSONFailure) {
+        return JSONFailure;
+    }
+    return unescape_string(string_start + 1, (size_t)(*string - string_start - 2), NULL, NULL);
+}
+
+/* Skips the name of a member and the colon after it */
+static JSON_Status tape_skip_name(const char **string, const char *end)
+{
+    if (tape_skip_string(string, end) == JSONFailure) {
+        return JSONFailure;
+    }
+    SKIP_WHITESPACES(string, end);
+    if (CURRENT_CHAR(string, end) != ':') {
+        return JSONFailure;
+    }
+    SKIP_CHAR(string);
+    return JSONSuccess;
+}
+
+/* Validates the container string points at as parse_value would, and records it and every
+   container in it on the tape instead of building values. Like parse_value, it does not recurse.
+   Duplicate names are left to lazy_materialize. */
+static JSON_Status tape_build(JSON_Tape *tape, const char *string, const char *end)
+{
+    JSON_Index_Stack open; /* index on the tape of every open container */
+    JSON_Tape_Entry *entry = NULL;
+    JSON_Status status = JSONFailure;
+    double number = 0;
+    int is_object = 0;
+    char c = '\0';
+    index_stack_init(&open);
+    for (;;) {
+        SKIP_WHITESPACES(&string, end);
+        c = CURRENT_CHAR(&string, end);
+        if (c == '{' || c == '[') {
+            if (open.count >= parson_nesting_limit ||
+                tape_push(tape, (size_t)(string + 1 - tape->text)) == JSONFailure ||
+                index_stack_push(&open, tape->count - 1) == JSONFailure) {
+                goto end;
+            }
+            SKIP_CHAR(&string);
+            SKIP_WHITESPACES(&string, end);
+            if (CURRENT_CHAR(&string, end) != (c == '{' ? '}' : ']')) {
+                if (c == '{' && tape_skip_name(&string, end) == JSONFailure) {
+                    goto end;
+                }
+                continue;
+            }
+            SKIP_CHAR(&string); /* empty, closed below as a value of its parent */
+            entry = &tape->entries[tape->count - 1];
+            entry->end = (size_t)(string - tape->text);
+            entry->next = tape->count;
+            open.count--;
+        } else if (c == '\"') {
+            if (tape_skip_string(&string, end) == JSONFailure) {
+                goto end;
+            }
+        } else if (c == 't' || c == 'f' || c == 'n') {
+            if (!skip_token(&string, end, "true", SIZEOF_TOKEN("true")) &&
+                !skip_token(&string, end, "false", SIZEOF_TOKEN("false")) &&
+                !skip_token(&string, end, "null", SIZEOF_TOKEN("null"))) {
+                goto end;
+            }
+        } else if (c == '-' || (c >= '0' && c <= '9')) {
+            if (parse_number(&string, end, &number) == JSONFailure) {
+                goto end;
+            }
+        } else {
+            goto end;
+        }
+        /* a value is complete, count it and close the containers that end after it */
+        while (open.count > 0) {
+            entry = &tape->entries[open.items[open.count - 1]];
+            is_object = tape->text[entry->start - 1] == '{';
+            entry->count++;
+            SKIP_WHITESPACES(&string, end);
+            if (CURRENT_CHAR(&string, end) == ',') {
+                SKIP_CHAR(&string);
+                SKIP_WHITESPACES(&string, end);
+                if (is_object && tape_skip_name(&string, end) == JSONFailure) {
+                    goto end;
+                }
+                break;
+            }
+            if (CURRENT_CHAR(&string, end) != (is_object ? '}' : ']')) {
+                goto end;
+            }
+            SKIP_CHAR(&string);
+            entry->end = (size_t)(string - tape->text);
+            entry->next = tape->count;
+            open.count--;
+        }
+        if (open.count == 0) {
+            status = JSONSuccess;
+            goto end;
+        }
+    }
+end:
+    index_stack_free(&open);
+    return status;
+}
+
+/* An unparsed container keeps its tape and its index on the tape in its payload, which has room
+   for a pointer and an unsigned int on every target */
+static JSON_Value *lazy_value_init(JSON_Tape *tape, size_t index)
+{
+    unsigned int tape_index = (unsigned int)index;
+    JSON_Value *new_value = NULL;
+    if (tape->text[tape->entries[index].start - 1] == '{') {
+        new_value = json_value_alloc(NULL, JSONObject);
+    } else {
+        new_value = json_value_alloc(NULL, JSONArray);
+    }
+    if (new_value == NULL) {
+        return NULL;
+    }
+    new_value->flags |= VALUE_FLAG_LAZY;
+    memcpy(new_value->payload, &tape, sizeof(tape));
+    memcpy(new_value->payload + sizeof(tape), &tape_index, sizeof(tape_index));
+    tape->refs++;
+    return new_value;
+}
+
+static JSON_Tape *lazy_value_get_tape(const JSON_Value *value, size_t *index)
+{
+    JSON_Tape *tape = NULL;
+    unsigned int tape_index = 0;
+    memcpy(&tape, value->payload, sizeof(tape));
+    memcpy(&tape_index, value->payload + sizeof(tape), sizeof(tape_index));
+    *index = tape_index;
+    return tape;
+}
+
+/* Parses the members of an unparsed container. Those that are containers are left unparsed,
+   their text is skipped using the tape. The input was validated by tape_build, only duplicate
+   names and running out of memory can fail. */
+static JSON_Status lazy_materialize(JSON_Value *value)
+{
+    JSON_Parser parser;
+    JSON_Tape *tape = NULL;
+    const JSON_Tape_Entry *entry = NULL;
+    JSON_Value *container = NULL, *member = NULL;
+    JSON_Object *object = NULL;
+    JSON_Value_Value payload;
+    const char *string = NULL;
+    char *name = NULL;
+    size_t index = 0, next = 0, i = 0;
+    tape = lazy_value_get_tape(value, &index);
+    entry = &tape->entries[index]; /* its count is of validated members, safe to reserve */
+    if (json_value_get_type(value) == JSONObject) {
+        container = json_value_init_object_arena(NULL);
+        object = json_value_get_object(container);
+        if (object == NULL) {
+            goto error;
+        }
+        /* the intern table set now need not be the one set when parsing, nor outlive value */
+        object->intern_table = NULL;
+        if (json_object_reserve(object, entry->count) == JSONFailure) {
+            goto error;
+        }
+    } else {
+        container = json_value_init_array_arena(NULL);
+        if (container == NULL ||
+            json_array_reserve(json_value_get_array(container), entry->count) == JSONFailure) {
+            goto error;
+        }
+    }
+    parser.arena = NULL;
+    parser.insitu = 0;
+    parser.end = tape->text + entry->end;
+    parser.member_counts = NULL; /* containers are never opened by parse_value_start here */
+    parser.next_container = 0;
+    string = tape->text + entry->start;
+    next = index + 1; /* the containers among the members follow on the tape */
+    for (i = 0; i < entry->count; i++) {
+        SKIP_WHITESPACES(&string, parser.end);
+        if (i > 0) {
+            SKIP_CHAR(&string); /* ',' */
+            SKIP_WHITESPACES(&string, parser.end);
+        }
+        if (object != NULL) {
+            name = parse_member_name(&string, object, &parser);
+            if (name == NULL) {
+                goto error;
+            }
+            SKIP_WHITESPACES(&string, parser.end);
+        }
+        if (CURRENT_CHAR(&string, parser.end) == '{' || CURRENT_CHAR(&string, parser.end) == '[') {
+            member = lazy_value_init(tape, next);
+            string = tape->text + tape->entries[next].end;
+            next = tape->entries[next].next;
+        } else {
+            member = parse_value_start(&string, &parser);
+        }
+        if (member == NULL) {
+            goto error;
+        }
+        if (parse_attach(container, name, member) == JSONFailure) {
+            name = NULL;
+            json_value_free(member);
+            goto error;
+        }
+        name = NULL;
+    }
+    /* moves the members over to value */
+    for (i = 0; i < entry->count; i++) {
+        json_value_get_member_at(container, i)->parent = value;
+    }
+    payload = json_value_get_payload(container);
+    if (object != NULL) {
+        object->wrapping_value = value;
+    } else {
+        payload.array->wrapping_value = value;
+    }
+    json_value_set_payload(value, payload);
+    value->flags &= ~VALUE_FLAG_LAZY;
+    parson_free(container);
+    tape_release(tape);
+    return JSONSuccess;
+error:
+    if (name != NULL) {
+        json_object_free_name(object, name);
+    }
+    json_value_free(container);
+    return JSONFailure;
+}
+
+/* Decoding into structs */
+/* Compares a name as escaped in the input with an unescaped one, without copying it */
+static int escaped_name_equals(const char *escaped, size_t escaped_len, const char *name,
+                               size_t name_len)
+{
+    const char *escaped_end = escaped + escaped_len, *name_end = name + name_len;
+    char buf[4];
+    char *buf_ptr = NULL;
+    size_t n = 0;
+    if (memchr(escaped, '\\', escaped_len) == NULL) {
+        return escaped_len == name_len && memcmp(escaped, name, name_len) == 0;
+    }
+    while (escaped < escaped_end) {
+        if (*escaped != '\\') {
+            if (name == name_end || *escaped++ != *name++) {
+                return 0;
+            }
+            continue;
+        }
+        buf_ptr = buf;
+        if (unescape_sequence(&escaped, &buf_ptr, escaped_end) == JSONFailure) {
+            return 0;
+        }
+        n = (size_t)(buf_ptr - buf);
+        if ((size_t)(name_end - name) < n || memcmp(buf, name, n) != 0) {
+            return 0;
+        }
+        name += n;
+    }
+    return name == name_end;
+}
+
+/* Whether the dotted path names the member at depth, below the root object */
+static int decoder_path_matches(const JSON_Decoder *decoder, const char *path, size_t depth)
+{
+    const char *dot_position = NULL;
+    size_t i, segment_len = 0;
+    for (i = 1; i <= depth; i++) {
+        if (decoder->names[i] == NULL) {
+            return 0;
+        }
+        dot_position = strchr(path, '.');
+        if ((dot_position == NULL) != (i == depth)) {
+            return 0; /* the path is shorter or longer than depth */
+        }
+        segment_len = dot_position != NULL ? (size_t)(dot_position - path) : strlen(path);
+        if (!escaped_name_equals(decoder->names[i], decoder->name_lengths[i], path,
+                                 segment_len)) {
+            return 0;
+        }
+        path += segment_len + 1;
+    }
+    return 1;
+}
+
+static void decoder_store(JSON_Decoder *decoder, size_t field_index, const JSON_Event *event)
+{
+    const JSON_Field *field = &decoder->fields[field_index];
+    JSON_Field_Status *status = &decoder->statuses[field_index];
+    char *member = decoder->target + field->offset;
+    int boolean = 0;
+    if (field->type == JSONFieldString && event->type == JSONEventString) {
+        if (event->length >= field->size) {
+            *status = JSONFieldTooLong;
+            return;
+        }
+        *status = unescape_string(event->string, event->length, member, NULL) == JSONSuccess
+                      ? JSONFieldDecoded
+                      : JSONFieldMistyped;
+    } else if (field->type == JSONFieldNumber && event->type == JSONEventNumber &&
+               field->size == sizeof(double)) {
+        memcpy(member, &event->number, sizeof(double));
+        *status = JSONFieldDecoded;
+    } else if (field->type == JSONFieldBoolean && event->type == JSONEventBoolean &&
+               field->size == sizeof(int)) {
+        boolean = event->boolean;
+        memcpy(member, &boolean, sizeof(int));
+        *status = JSONFieldDecoded;
+    } else {
+        *status = JSONFieldMistyped;
+    }
+}
+
+static int decoder_handle_event(const JSON_Event *event, void *context)
+{
+    JSON_Decoder *decoder = (JSON_Decoder *)context;
+    size_t i;
+    if (event->type == JSONEventKey) {
+        if (event->depth < DECODER_MAX_DEPTH) {
+            decoder->names[event->depth] = event->string;
+            decoder->name_lengths[event->depth] = event->length;
+        }
+        return 1;
+    }
+    if (event->type == JSONEventEndObject || event->type == JSONEventEndArray) {
+        return 1;
+    }
+    if (event->type == JSONEventStartArray && event->depth + 1 < DECODER_MAX_DEPTH) {
+        decoder->names[event->depth + 1] = NULL; /* items have no names */
+    }
+    if (event->depth == 0 || event->depth >= DECODER_MAX_DEPTH) {
+        return 1;
+    }
+    for (i = 0; i < decoder->field_count; i++) {
+        if (decoder_path_matches(decoder, decoder->fields[i].path, event->depth)) {
+            decoder_store(decoder, i, event);
+        }
+    }
+    return 1;
+}
+
+/* Number formatting */
+/* Grisu2 (Florian Loitsch, "Printing Floating-Point Numbers Quickly and Accurately with Integers",
+   PLDI 2010): the digits always parse back to the same double and are the shortest such digits
+   for all but a tiny fraction of values, using 64-bit integer arithmetic only.
+   Powers of ten 10^k for k = -300..324 in steps of 8, as normalized f * 2^e */
+static const JSON_Cached_Power cached_powers[] = {
+    {UINT64_C(0xAB70FE17C79AC6CA), -1060, -300},
+    {UINT64_C(0xFF77B1FCBEBCDC4F), -1034, -292},
+    {UINT64_C(0xBE5691EF416BD60C), -1007, -284},
+    {UINT64_C(0x8DD01FAD907FFC3C), -980, -276},
+    {UINT64_C(0xD3515C2831559A83), -954, -268},
+    {UINT64_C(0x9D71AC8FADA6C9B5), -927, -260},
+    {UINT64_C(0xEA9C227723EE8BCB), -901, -252},
+    {UINT64_C(0xAECC49914078536D), -874, -244},
+    {UINT64_C(0x823C12795DB6CE57), -847, -236},
+    {UINT64_C(0xC21094364DFB5637), -821, -228},
+    {UINT64_C(0x9096EA6F3848984F), -794, -220},
+    {UINT64_C(0xD77485CB25823AC7), -768, -212},
+    {UINT64_C(0xA086CFCD97BF97F4), -741, -204},
+    {UINT64_C(0xEF340A98172AACE5), -715, -196},
+    {UINT64_C(0xB23867FB2A35B28E), -688, -188},
+    {UINT64_C(0x84C8D4DFD2C63F3B), -661, -180},
+    {UINT64_C(0xC5DD44271AD3CDBA), -635, -172},
+    {UINT64_C(0x936B9FCEBB25C996), -608, -164},
+    {UINT64_C(0xDBAC6C247D62A584), -582, -156},
+    {UINT64_C(0xA3AB66580D5FDAF6), -555, -148},
+    {UINT64_C(0xF3E2F893DEC3F126), -529, -140},
+    {UINT64_C(0xB5B5ADA8AAFF80B8), -502, -132},
+    {UINT64_C(0x87625F056C7C4A8B), -475, -124},
+    {UINT64_C(0xC9BCFF6034C13053), -449, -116},
+    {UINT64_C(0x964E858C91BA2655), -422, -108},
+    {UINT64_C(0xDFF9772470297EBD), -396, -100},
+    {UINT64_C(0xA6DFBD9FB8E5B88F), -369, -92},
+    {UINT64_C(0xF8A95FCF88747D94), -343, -84},
+    {UINT64_C(0xB94470938FA89BCF), -316, -76},
+    {UINT64_C(0x8A08F0F8BF0F156B), -289, -68},
+    {UINT64_C(0xCDB02555653131B6), -263, -60},
+    {UINT64_C(0x993FE2C6D07B7FAC), -236, -52},
+    {UINT64_C(0xE45C10C42A2B3B06), -210, -44},
+    {UINT64_C(0xAA242499697392D3), -183, -36},
+    {UINT64_C(0xFD87B5F28300CA0E), -157, -28},
+    {UINT64_C(0xBCE5086492111AEB), -130, -20},
+    {UINT64_C(0x8CBCCC096F5088CC), -103, -12},
+    {UINT64_C(0xD1B71758E219652C), -77, -4},
+    {UINT64_C(0x9C40000000000000), -50, 4},
+    {UINT64_C(0xE8D4A51000000000), -24, 12},
+    {UINT64_C(0xAD78EBC5AC620000), 3, 20},
+    {UINT64_C(0x813F3978F8940984), 30, 28},
+    {UINT64_C(0xC097CE7BC90715B3), 56, 36},
+    {UINT64_C(0x8F7E32CE7BEA5C70), 83, 44},
+    {UINT64_C(0xD5D238A4ABE98068), 109, 52},
+    {UINT64_C(0x9F4F2726179A2245), 136, 60},
+    {UINT64_C(0xED63A231D4C4FB27), 162, 68},
+    {UINT64_C(0xB0DE65388CC8ADA8), 189, 76},
+    {UINT64_C(0x83C7088E1AAB65DB), 216, 84},
+    {UINT64_C(0xC45D1DF942711D9A), 242, 92},
+    {UINT64_C(0x924D692CA61BE758), 269, 100},
+    {UINT64_C(0xDA01EE641A708DEA), 295, 108},
+    {UINT64_C(0xA26DA3999AEF774A), 322, 116},
+    {UINT64_C(0xF209787BB47D6B85), 348, 124},
+    {UINT64_C(0xB454E4A179DD1877), 375, 132},
+    {UINT64_C(0x865B86925B9BC5C2), 402, 140},
+    {UINT64_C(0xC83553C5C8965D3D), 428, 148},
+    {UINT64_C(0x952AB45CFA97A0B3), 455, 156},
+    {UINT64_C(0xDE469FBD99A05FE3), 481, 164},
+    {UINT64_C(0xA59BC234DB398C25), 508, 172},
+    {UINT64_C(0xF6C69A72A3989F5C), 534, 180},
+    {UINT64_C(0xB7DCBF5354E9BECE), 561, 188},
+    {UINT64_C(0x88FCF317F22241E2), 588, 196},
+    {UINT64_C(0xCC20CE9BD35C78A5), 614, 204},
+    {UINT64_C(0x98165AF37B2153DF), 641, 212},
+    {UINT64_C(0xE2A0B5DC971F303A), 667, 220},
+    {UINT64_C(0xA8D9D1535CE3B396), 694, 228},
+    {UINT64_C(0xFB9B7CD9A4A7443C), 720, 236},
+    {UINT64_C(0xBB764C4CA7A44410), 747, 244},
+    {UINT64_C(0x8BAB8EEFB6409C1A), 774, 252},
+    {UINT64_C(0xD01FEF10A657842C), 800, 260},
+    {UINT64_C(0x9B10A4E5E9913129), 827, 268},
+    {UINT64_C(0xE7109BFBA19C0C9D), 853, 276},
+    {UINT64_C(0xAC2820D9623BF429), 880, 284},
+    {UINT64_C(0x80444B5E7AA7CF85), 907, 292},
+    {UINT64_C(0xBF21E44003ACDD2D), 933, 300},
+    {UINT64_C(0x8E679C2F5E44FF8F), 960, 308},
+    {UINT64_C(0xD433179D9C8CB841), 986, 316},
+    {UINT64_C(0x9E19DB92B4E31BA9), 1013, 324},};
+
+static JSON_Diy_Fp diy_fp_sub(JSON_Diy_Fp x, JSON_Diy_Fp y)
+{
+    x.f -= y.f;
+    return x;
+}
+
+/* Product rounded to the upper 64 bits */
+static JSON_Diy_Fp diy_fp_mul(JSON_Diy_Fp x, JSON_Diy_Fp y)
+{
+    JSON_Diy_Fp result;
+    uint64_t x_lo = x.f & 0xFFFFFFFFu, x_hi = x.f >> 32;
+    uint64_t y_lo = y.f & 0xFFFFFFFFu, y_hi = y.f >> 32;
+    uint64_t p0 = x_lo * y_lo, p1 = x_lo * y_hi, p2 = x_hi * y_lo, p3 = x_hi * y_hi;
+    uint64_t q = (p0 >> 32) + (p1 & 0xFFFFFFFFu) + (p2 & 0xFFFFFFFFu) + ((uint64_t)1 << 31);
+    result.f = p3 + (p2 >> 32) + (p1 >> 32) + (q >> 32);
+    result.e = x.e + y.e + 64;
+    return result;
+}
+
+static JSON_Diy_Fp diy_fp_normalize(JSON_Diy_Fp x)
+{
+    while ((x.f >> 63) == 0) {
+        x.f <<= 1;
+        x.e--;
+    }
+    return x;
+}
+
+/* Splits a positive finite double into v and the boundaries m_minus and m_plus of the interval
+   of reals rounding to it, normalized to the exponent of m_plus */
+static void compute_boundaries(double value, JSON_Diy_Fp *v, JSON_Diy_Fp *m_minus,
+                               JSON_Diy_Fp *m_plus)
+{
+    const uint64_t hidden_bit = (uint64_t)1 << 52;
+    uint64_t bits = 0, fraction = 0;
+    int biased_exponent = 0, lower_boundary_is_closer = 0;
+    memcpy(&bits, &value, sizeof(bits));
+    biased_exponent = (int)(bits >> 52) & 0x7FF;
+    fraction = bits & (hidden_bit - 1);
+    if (biased_exponent == 0) { /* subnormal */
+        v->f = fraction;
+        v->e = 1 - 1075;
+    } else {
+        v->f = fraction | hidden_bit;
+        v->e = biased_exponent - 1075;
+    }
+    lower_boundary_is_closer = fraction == 0 && biased_exponent > 1;
+    m_plus->f = 2 * v->f + 1;
+    m_plus->e = v->e - 1;
+    if (lower_boundary_is_closer) {
+        m_minus->f = 4 * v->f - 1;
+        m_minus->e = v->e - 2;
+    } else {
+        m_minus->f = 2 * v->f - 1;
+        m_minus->e = v->e - 1;
+    }
+    *m_plus = diy_fp_normalize(*m_plus);
+    m_minus->f <<= m_minus->e - m_plus->e;
+    m_minus->e = m_plus->e;
+    *v = diy_fp_normalize(*v);
+}
+
+/* Cached power c such that the exponent of c times a value with binary exponent e falls
+   within [-60, -32] */
+static const JSON_Cached_Power *get_cached_power(int e)
+{
+    int f = -60 - e - 1;
+    int k = (f * 78913) / (1 << 18) + (f > 0);
+    int index = (300 + k + 7) / 8;
+    return &cached_powers[index];
+}
+
+/* Moves the last digit closer to w while staying within the rounding interval */
+static void grisu2_round(char *buf, int len, uint64_t dist, uint64_t delta, uint64_t rest,
+                         uint64_t ten_k)
+{
+    while (rest < dist && delta - rest >= ten_k &&
+           (rest + ten_k < dist || dist - rest > rest + ten_k - dist)) {
+        buf[len - 1]--;
+        rest += ten_k;
+    }
+}
+
+/* Generates the digits of w, shortest within (m_minus, m_plus), into buf */
+static int grisu2_digit_gen(char *buf, int *decimal_exponent, JSON_Diy_Fp m_minus, JSON_Diy_Fp w,
+                            JSON_Diy_Fp m_plus)
+{
+    uint64_t delta = diy_fp_sub(m_plus, m_minus).f, dist = diy_fp_sub(m_plus, w).f;
+    int shift = -m_plus.e; /* within [32, 60] */
+    uint64_t one = (uint64_t)1 << shift;
+    uint32_t p1 = (uint32_t)(m_plus.f >> shift), pow10 = 1000000000u;
+    uint64_t p2 = m_plus.f & (one - 1), rest = 0;
+    int len = 0, n = 10, m = 0;
+    while (n > 1 && p1 < pow10) {
+        pow10 /= 10;
+        n--;
+    }
+    while (n > 0) {
+        buf[len++] = (char)('0' + p1 / pow10);
+        p1 %= pow10;
+        n--;
+        rest = ((uint64_t)p1 << shift) + p2;
+        if (rest <= delta) {
+            *decimal_exponent += n;
+            grisu2_round(buf, len, dist, delta, rest, (uint64_t)pow10 << shift);
+            return len;
+        }
+        pow10 /= 10;
+    }
+    for (;;) {
+        p2 *= 10;
+        buf[len++] = (char)('0' + (p2 >> shift));
+        p2 &= one - 1;
+        m++;
+        delta *= 10;
+        dist *= 10;
+        if (p2 <= delta) {
+            break;
+        }
+    }
+    *decimal_exponent -= m;
+    grisu2_round(buf, len, dist, delta, p2, one);
+    return len;
+}
+
+/* Writes the digits of a positive finite double into buf, returns their count; the value is
+   digits * 10^decimal_exponent */
+static int grisu2(char *buf, int *decimal_exponent, double value)
+{
+    JSON_Diy_Fp v, m_minus, m_plus, c, w, w_minus, w_plus;
+    const JSON_Cached_Power *cached = NULL;
+    compute_boundaries(value, &v, &m_minus, &m_plus);
+    cached = get_cached_power(m_plus.e);
+    c.f = cached->f;
+    c.e = cached->e;
+    w = diy_fp_mul(v, c);
+    w_minus = diy_fp_mul(m_minus, c);
+    w_plus = diy_fp_mul(m_plus, c);
+    /* the products may be off by one ulp, so the interval is shrunk to stay within it */
+    w_minus.f += 1;
+    w_plus.f -= 1;
+    *decimal_exponent = -cached->k;
+    return grisu2_digit_gen(buf, decimal_exponent, w_minus, w, w_plus);
+}
+
+/* Formats a finite double like ECMAScript's Number.prototype.toString: the shortest digits that
+   round-trip, in plain notation for exponents in (-7, 21] and in exponential notation otherwise.
+   Returns the length written into buf, which must hold NUM_BUF_SIZE bytes. */
+static int format_number(char *buf, double number)
+{
+    char digits[18];
+    char *ptr = buf;
+    int len = 0, decimal_exponent = 0, point = 0, exponent = 0, i;
+    uint64_t bits = 0;
+    memcpy(&bits, &number, sizeof(bits));
+    if (bits >> 63) {
+        *ptr++ = '-';
+        number = -number;
+    }
+    if (number == 0.0) {
+        *ptr++ = '0';
+        *ptr = '\0';
+        return (int)(ptr - buf);
+    }
+    len = grisu2(digits, &decimal_exponent, number);
+    point = len + decimal_exponent; /* digits[0] has weight 10^(point - 1) */
+    if (len <= point && point <= 21) { /* 1234e7 -> 12340000000 */
+        memcpy(ptr, digits, (size_t)len);
+        memset(ptr + len, '0', (size_t)(point - len));
+        ptr += point;
+    } else if (0 < point && point <= 21) { /* 1234e-2 -> 12.34 */
+        memcpy(ptr, digits, (size_t)point);
+        ptr[point] = '.';
+        memcpy(ptr + point + 1, digits + point, (size_t)(len - point));
+        ptr += len + 1;
+    } else if (-6 < point && point <= 0) { /* 1234e-6 -> 0.001234 */
+        ptr[0] = '0';
+        ptr[1] = '.';
+        memset(ptr + 2, '0', (size_t)-point);
+        memcpy(ptr + 2 - point, digits, (size_t)len);
+        ptr += 2 - point + len;
+    } else { /* 1234e30 -> 1.234e+33 */
+        *ptr++ = digits[0];
+        if (len > 1) {
+            *ptr++ = '.';
+            memcpy(ptr, digits + 1, (size_t)(len - 1));
+            ptr += len - 1;
+        }
+        exponent = point - 1;
+        *ptr++ = 'e';
+        *ptr++ = exponent < 0 ? '-' : '+';
+        exponent = exponent < 0 ? -exponent : exponent;
+        for (i = exponent >= 100 ? 100 : exponent >= 10 ? 10 : 1; i > 0; i /= 10) {
+            *ptr++ = (char)('0' + exponent / i % 10);
+        }
+    }
+    *ptr = '\0';
+    return (int)(ptr - buf);
+}
+
+/* Formats a finite double rounded half up to decimals digits after the point, in plain notation
+   and without trailing zeros. Returns the length written into buf, which must hold NUM_BUF_SIZE
+   bytes, or -1 when the rounded digits do not fit in the 53 bits of a double. */
+static int format_number_fixed(char *buf, double number, int decimals)
+{
+    static const double powers_of_ten[NUMBER_DECIMALS_MAX + 1] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15};
+    char digits[20]; /* least significant first */
+    char *ptr = buf;
+    double scaled = fabs(number) * powers_of_ten[decimals];
+    uint64_t rounded = 0;
+    uint32_t low = 0;
+    int len = 0, first = 0, i;
+    if (!(scaled < 9007199254740992.0)) { /* 2^53 */
+        return -1;
+    }
+    rounded = (uint64_t)scaled;
+    rounded += scaled - (double)rounded >= 0.5; /* the difference is exact below 2^53 */
+    while (rounded > 0xFFFFFFFF) { /* 64-bit division is a library call on 32-bit targets */
+        digits[len++] = (char)('0' + (int)(rounded % 10));
+        rounded /= 10;
+    }
+    low = (uint32_t)rounded;
+    do {
+        digits[len++] = (char)('0' + (int)(low % 10));
+        low /= 10;
+    } while (low > 0);
+    if (len == 1 && digits[0] == '0') { /* no "-0" for small negative numbers */
+        buf[0] = '0';
+        buf[1] = '\0';
+        return 1;
+    }
+    while (decimals > 0 && digits[first] == '0') {
+        first++;
+        decimals--;
+    }
+    if (number < 0) {
+        *ptr++ = '-';
+    }
+    if (len - first <= decimals) { /* 0.0xyz */
+        *ptr++ = '0';
+        *ptr++ = '.';
+        for (i = len - first; i < decimals; i++) {
+            *ptr++ = '0';
+        }
+    }
+    for (i = len - 1; i >= first; i--) {
+        if (i - first == decimals - 1 && i < len - 1) {
+            *ptr++ = '.';
+        }
+        *ptr++ = digits[i];
+    }
+    *ptr = '\0';
+    return (int)(ptr - buf);
+}
+
+/* Serialization */
+/* str must be a string literal, its length is known at compile time */
+#define APPEND_STRING(str)                                                    \
+    do {                                                                      \
+        if (writer_append(writer, (str), SIZEOF_TOKEN(str)) == JSONFailure) { \
+            return JSONFailure;                                               \
+        }                                                                     \
+    } while (0)
+
+#define APPEND_INDENT(level)                                  \
+    do {                                                      \
+        if (append_indent(writer, (level)) == JSONFailure) { \
+            return JSONFailure;                               \
+        }                                                     \
+    } while (0)
+
+static void writer_init(JSON_Writer *writer, char *buf, size_t capacity, int can_grow)
+{
+    writer->buf = buf;
+    writer->length = 0;
+    writer->capacity = capacity;
+    writer->can_grow = can_grow;
+    writer->sink = NULL;
+    writer->sink_context = NULL;
+}
+
+/* Makes room for n more bytes and the terminating '\0', always succeeds when measuring */
+static JSON_Status writer_reserve(JSON_Writer *writer, size_t n)
+{
+    size_t new_capacity = 0;
+    char *new_buf = NULL;
+    if (writer->buf == NULL && !writer->can_grow) {
+        return JSONSuccess;
+    }
+    if (writer->capacity - writer->length > n) {
+        return JSONSuccess;
+    }
+    if (!writer->can_grow) {
+        return JSONFailure;
+    }
+    new_capacity = MAX(writer->capacity * 2, WRITER_DEFAULT_CAPACITY);
+    while (new_capacity - writer->length <= n) {
+        new_capacity *= 2;
+    }
+    new_buf = (char *)parson_malloc(new_capacity);
+    if (new_buf == NULL) {
+        return JSONFailure;
+    }
+    if (writer->buf != NULL) {
+        memcpy(new_buf, writer->buf, writer->length);
+        parson_free(writer->buf);
+    }
+    writer->buf = new_buf;
+    writer->capacity = new_capacity;
+    return JSONSuccess;
+}
+
+static JSON_Status writer_append(JSON_Writer *writer, const char *data, size_t n)
+{
+    if (writer->sink != NULL) {
+        return writer_append_to_sink(writer, data, n);
+    }
+    if (writer_reserve(writer, n) == JSONFailure) {
+        return JSONFailure;
+    }
+    if (writer->buf != NULL) {
+        memcpy(writer->buf + writer->length, data, n);
+    }
+    writer->length += n;
+    return JSONSuccess;
+}
+
+/* Hands the buffered bytes to the sink */
+static JSON_Status writer_flush(JSON_Writer *writer)
+{
+    if (writer->length > 0 &&
+        writer->sink(writer->buf, writer->length, writer->sink_context) == JSONFailure) {
+        return JSONFailure;
+    }
+    writer->length = 0;
+    return JSONSuccess;
+}
+
+/* Buffers data, flushing whenever the buffer fills up. Chunks are never larger than it. */
+static JSON_Status writer_append_to_sink(JSON_Writer *writer, const char *data, size_t n)
+{
+    size_t chunk = 0;
+    while (n > 0) {
+        if (writer->length == writer->capacity && writer_flush(writer) == JSONFailure) {
+            return JSONFailure;
+        }
+        chunk = MIN(n, writer->capacity - writer->length);
+        memcpy(writer->buf + writer->length, data, chunk);
+        writer->length += chunk;
+        data += chunk;
+        n -= chunk;
+    }
+    return JSONSuccess;
+}
+
+static JSON_Status serialize_to_sink(const JSON_Value *value, JSON_Sink_Function sink,
+                                     void *context, int is_pretty)
+{
+    JSON_Writer writer;
+    char buf[SINK_BUFFER_SIZE];
+    if (sink == NULL) {
+        return JSONFailure;
+    }
+    writer_init(&writer, buf, sizeof(buf), 0);
+    writer.sink = sink;
+    writer.sink_context = context;
+    if (json_serialize_value(value, &writer, is_pretty) == JSONFailure) {
+        return JSONFailure;
+    }
+    return writer_flush(&writer);
+}
+
+/* decimals is -1 for the shortest representation */
+static JSON_Status writer_append_number(JSON_Writer *writer, double number, int decimals)
+{
+    char num_buf[NUM_BUF_SIZE];
+    int len = -1;
+    if ((number * 0.0) != 0.0) { /* nan and inf have no JSON representation */
+        return JSONFailure;
+    }
+    if (decimals >= 0) {
+        len = format_number_fixed(num_buf, number, decimals);
+    }
+    if (len < 0) {
+        len = format_number(num_buf, number);
+    }
+    return writer_append(writer, num_buf, (size_t)len);
+}
+
+static void writer_terminate(JSON_Writer *writer)
+{
+    if (writer->buf != NULL) {
+        writer->buf[writer->length] = '\0'; /* writer_reserve always keeps room for it */
+    }
+}
+
+static void index_stack_init(JSON_Index_Stack *stack)
+{
+    stack->items = stack->inline_items;
+    stack->count = 0;
+    stack->capacity = INDEX_STACK_INLINE_SIZE;
+}
+
+static JSON_Status index_stack_push(JSON_Index_Stack *stack, size_t index)
+{
+    size_t *new_items = NULL;
+    if (stack->count == stack->capacity) {
+        new_items = (size_t *)parson_malloc(stack->capacity * 2 * sizeof(size_t));
+        if (new_items == NULL) {
+            return JSONFailure;
+        }
+        memcpy(new_items, stack->items, stack->count * sizeof(size_t));
+        if (stack->items != stack->inline_items) {
+            parson_free(stack->items);
+        }
+        stack->items = new_items;
+        stack->capacity *= 2;
+    }
+    stack->items[stack->count++] = index;
+    return JSONSuccess;
+}
+
+static void index_stack_free(JSON_Index_Stack *stack)
+{
+    if (stack->items != stack->inline_items) {
+        parson_free(stack->items);
+    }
+}
+
+/* Number of members of an object or items of an array, 0 for other values */
+static size_t json_value_get_member_count(const JSON_Value *value)
+{
+    switch (json_value_get_type(value)) {
+    case JSONObject:
+        return json_object_get_count(json_value_get_object(value));
+    case JSONArray:
+        return json_array_get_count(json_value_get_array(value));
+    default:
+        return 0;
+    }
+}
+
+static JSON_Value *json_value_get_member_at(const JSON_Value *container, size_t index)
+{
+    JSON_Object *object = json_value_get_object(container);
+    if (object != NULL) {
+        return json_object_get_value_at(object, index);
+    }
+    return json_array_get_value(json_value_get_array(container), index);
+}
+
+/* Writes the indentation and the name of a member, returns its value or NULL on failure */
+static const JSON_Value *serialize_member_start(const JSON_Value *container, size_t index,
+                                                JSON_Writer *writer, size_t level, int is_pretty)
+{
+    JSON_Object *object = json_value_get_object(container);
+    const char *key = NULL;
+    if (is_pretty && append_indent(writer, (int)level) == JSONFailure) {
+        return NULL;
+    }
+    if (object == NULL) {
+        return json_array_get_value(json_value_get_array(container), index);
+    }
+    key = json_object_get_name(object, index);
+    if (key == NULL || json_serialize_string(key, writer) == JSONFailure ||
+        writer_append(writer, ": ", is_pretty ? 2 : 1) == JSONFailure) {
+        return NULL;
+    }
+    return json_object_get_value_at(object, index);
+}
+
+/* Serializes a value that has no members */
+static JSON_Status serialize_leaf(const JSON_Value *value, JSON_Writer *writer)
+{
+    const char *string = NULL;
+    switch (json_value_get_type(value)) {
+    case JSONArray:
+        if (json_value_get_array(value) == NULL) {
+            return JSONFailure; /* a lazily parsed array that could not be parsed */
+        }
+        APPEND_STRING("[]");
+        return JSONSuccess;
+    case JSONObject:
+        if (json_value_get_object(value) == NULL) {
+            return JSONFailure;
+        }
+        APPEND_STRING("{}");
+        return JSONSuccess;
+    case JSONString:
+        string = json_value_get_string(value);
+        if (string == NULL) {
+            return JSONFailure;
+        }
+        return json_serialize_string(string, writer);
+    case JSONBoolean:
+        if (json_value_get_boolean(value)) {
+            APPEND_STRING("true");
+        } else {
+            APPEND_STRING("false");
+        }
+        return JSONSuccess;
+    case JSONNumber:
+        return writer_append_number(writer, json_value_get_number(value),
+                                    json_value_get_number_decimals(value));
+    case JSONNull:
+        APPEND_STRING("null");
+        return JSONSuccess;
+    case JSONError:
+        return JSONFailure;
+    default:
+        return JSONFailure;
+    }
+}
+
+/* Serializes value into writer in a single pass, without recursion. The index of the member
+   being written is kept for every open container, and finishing a value goes back up to its
+   parent. */
+static JSON_Status json_serialize_value(const JSON_Value *value, JSON_Writer *writer,
+                                        int is_pretty)
+{
+    JSON_Index_Stack stack;
+    const JSON_Value *container = NULL;
+    JSON_Status status = JSONFailure;
+    size_t index = 0;
+    char bracket[2];
+    index_stack_init(&stack);
+    for (;;) {
+        if (json_value_get_member_count(value) > 0) { /* opens value, goes on to its first member */
+            bracket[0] = json_value_get_type(value) == JSONObject ? '{' : '[';
+            bracket[1] = '\n';
+            if (writer_append(writer, bracket, is_pretty ? 2 : 1) == JSONFailure ||
+                index_stack_push(&stack, 0) == JSONFailure) {
+                goto end;
+            }
+            value = serialize_member_start(value, 0, writer, stack.count, is_pretty);
+            if (value == NULL) {
+                goto end;
+            }
+            continue;
+        }
+        if (serialize_leaf(value, writer) == JSONFailure) {
+            goto end;
+        }
+        /* value is complete, close the containers it ends or go on to the next member */
+        for (;;) {
+            if (stack.count == 0) {
+                status = JSONSuccess;
+                goto end;
+            }
+            container = json_value_get_parent(value);
+            index = ++stack.items[stack.count - 1];
+            if (index < json_value_get_member_count(container)) {
+                if (writer_append(writer, ",\n", is_pretty ? 2 : 1) == JSONFailure) {
+                    goto end;
+                }
+                value = serialize_member_start(container, index, writer, stack.count, is_pretty);
+                if (value == NULL) {
+                    goto end;
+                }
+                break;
+            }
+            stack.count--;
+            bracket[0] = '\n';
+            bracket[1] = json_value_get_type(container) == JSONObject ? '}' : ']';
+            if ((is_pretty && (writer_append(writer, bracket, 1) == JSONFailure ||
+                               append_indent(writer, (int)stack.count) == JSONFailure)) ||
+                writer_append(writer, bracket + 1, 1) == JSONFailure) {
+                goto end;
+            }
+            value = container;
+        }
+    }
+end:
+    index_stack_free(&stack);
+    return status;
+}
+
+static JSON_Status json_serialize_string(const char *string, JSON_Writer *writer)
+{
+    static const char hex_chars[] = "0123456789abcdef";
+    const char *run = string; /* first character not appended yet */
+    char escaped[] = "\\u0000";
+    char c = '\0';
+    APPEND_STRING("\"");
+    for (; *string != '\0'; string++) {
+        c = *string;
+        if ((unsigned char)c >= 0x20 && c != '\"' && c != '\\' && c != '/') {
+            continue;
+        }
+        if (writer_append(writer, run, (size_t)(string - run)) == JSONFailure) {
+            return JSONFailure;
+        }
+        run = string + 1;
+        switch (c) {
+        case '\"':
+            APPEND_STRING("\\\"");
+            break;
+        case '\\':
+            APPEND_STRING("\\\\");
+            break;
+        case '/':
+            APPEND_STRING("\\/");
+            break; /* to make json embeddable in xml\/html */
+        case '\b':
+            APPEND_STRING("\\b");
+            break;
+        case '\f':
+            APPEND_STRING("\\f");
+            break;
+        case '\n':
+            APPEND_STRING("\\n");
+            break;
+        case '\r':
+            APPEND_STRING("\\r");
+            break;
+        case '\t':
+            APPEND_STRING("\\t");
+            break;
+        default: /* remaining control characters */
+            escaped[4] = hex_chars[((unsigned char)c >> 4) & 0xF];
+            escaped[5] = hex_chars[(unsigned char)c & 0xF];
+            if (writer_append(writer, escaped, SIZEOF_TOKEN(escaped)) == JSONFailure) {
+                return JSONFailure;
+            }
+            break;
+        }
+    }
+    if (writer_append(writer, run, (size_t)(string - run)) == JSONFailure) {
+        return JSONFailure;
+    }
+    APPEND_STRING("\"");
+    return JSONSuccess;
+}
+
+static JSON_Status append_indent(JSON_Writer *writer, int level)
+{
+    int i;
+    for (i = 0; i < level; i++) {
+        APPEND_STRING("    ");
+    }
+    return JSONSuccess;
+}
+
+#undef APPEND_STRING
+#undef APPEND_INDENT
+
+/* CBOR */
+/* Writes the initial byte followed by size bytes of argument, most significant first */
+static JSON_Status cbor_write_argument(JSON_Writer *writer, unsigned int initial_byte,
+                                       uint64_t argument, size_t size)
+{
+    unsigned char bytes[9];
+    size_t i = 0;
+    bytes[0] = (unsigned char)initial_byte;
+    for (i = 0; i < size; i++) {
+        bytes[size - i] = (unsigned char)(argument >> (8 * i));
+    }
+    return writer_append(writer, (const char *)bytes, size + 1);
+}
+
+/* Writes the shortest head of a data item of type major */
+static JSON_Status cbor_write_head(JSON_Writer *writer, unsigned int major, uint64_t argument)
+{
+    if (argument < 24) {
+        return cbor_write_argument(writer, (major << 5) | (unsigned int)argument, 0, 0);
+    } else if (argument <= 0xff) {
+        return cbor_write_argument(writer, (major << 5) | 24, argument, 1);
+    } else if (argument <= 0xffff) {
+        return cbor_write_argument(writer, (major << 5) | 25, argument, 2);
+    } else if (argument <= 0xffffffffUL) {
+        return cbor_write_argument(writer, (major << 5) | 26, argument, 4);
+    }
+    return cbor_write_argument(writer, (major << 5) | 27, argument, 8);
+}
+
+/* Integral numbers become integers, others single precision floats when that is exact */
+static JSON_Status cbor_write_number(JSON_Writer *writer, double number)
+{
+    uint64_t bits = 0;
+    uint32_t single_bits = 0;
+    float single = 0;
+    if ((number * 0.0) != 0.0) { /* nan and inf have no JSON representation */
+        return JSONFailure;
+    }
+    memcpy(&bits, &number, sizeof(double));
+    if (number == floor(number) && number > -CBOR_TWO_TO_64 && number < CBOR_TWO_TO_64 &&
+        !(number == 0 && (bits >> 63) != 0)) { /* -0 stays a float */
+        if (number >= 0) {
+            return cbor_write_head(writer, CBOR_UNSIGNED, (uint64_t)number);
+        }
+        return cbor_write_head(writer, CBOR_NEGATIVE, (uint64_t)(-number) - 1);
+    }
+    if (fabs(number) <= CBOR_FLOAT_MAX) {
+        single = (float)number;
+        if ((double)single == number) {
+            memcpy(&single_bits, &single, sizeof(float));
+            return cbor_write_argument(writer, (CBOR_SIMPLE << 5) | CBOR_SINGLE, single_bits, 4);
+        }
+    }
+    return cbor_write_argument(writer, (CBOR_SIMPLE << 5) | CBOR_DOUBLE, bits, 8);
+}
+
+/* Writes a value whole, or only the head of a container */
+static JSON_Status cbor_write_item(const JSON_Value *value, JSON_Writer *writer)
+{
+    const char *string = NULL;
+    size_t length = 0;
+    switch (json_value_get_type(value)) {
+    case JSONObject:
+        if (json_value_get_object(value) == NULL) {
+            return JSONFailure; /* a lazily parsed object that could not be parsed */
+        }
+        return cbor_write_head(writer, CBOR_MAP, json_value_get_member_count(value));
+    case JSONArray:
+        if (json_value_get_array(value) == NULL) {
+            return JSONFailure;
+        }
+        return cbor_write_head(writer, CBOR_ARRAY, json_value_get_member_count(value));
+    case JSONString:
+        string = json_value_get_string(value);
+        length = strlen(string);
+        if (cbor_write_head(writer, CBOR_TEXT, length) == JSONFailure) {
+            return JSONFailure;
+        }
+        return writer_append(writer, string, length);
+    case JSONNumber:
+        return cbor_write_number(writer, json_value_get_number(value));
+    case JSONBoolean:
+        return cbor_write_head(writer, CBOR_SIMPLE,
+                               json_value_get_boolean(value) ? CBOR_TRUE : CBOR_FALSE);
+    case JSONNull:
+        return cbor_write_head(writer, CBOR_SIMPLE, CBOR_NULL);
+    default:
+        return JSONFailure;
+    }
+}
+
+/* Writes the name of a member, returns its value or NULL on failure */
+static const JSON_Value *cbor_write_member_start(const JSON_Value *container, size_t index,
+                                                 JSON_Writer *writer)
+{
+    JSON_Object *object = json_value_get_object(container);
+    const char *name = NULL;
+    size_t length = 0;
+    if (object == NULL) {
+        return json_array_get_value(json_value_get_array(container), index);
+    }
+    name = json_object_get_name(object, index);
+    length = strlen(name);
+    if (cbor_write_head(writer, CBOR_TEXT, length) == JSONFailure ||
+        writer_append(writer, name, length) == JSONFailure) {
+        return NULL;
+    }
+    return json_object_get_value_at(object, index);
+}
+
+/* Serializes value without recursion, like json_serialize_value: the index of the member being
+   written is kept for every open container. */
+static JSON_Status cbor_serialize_value(const JSON_Value *value, JSON_Writer *writer)
+{
+    JSON_Index_Stack stack;
+    const JSON_Value *container = NULL;
+    JSON_Status status = JSONFailure;
+    size_t index = 0;
+    index_stack_init(&stack);
+    for (;;) {
+        if (cbor_write_item(value, writer) == JSONFailure) {
+            goto end;
+        }
+        if (json_value_get_member_count(value) > 0) { /* goes on to the first member */
+            if (index_stack_push(&stack, 0) == JSONFailure) {
+                goto end;
+            }
+            value = cbor_write_member_start(value, 0, writer);
+            if (value == NULL) {
+                goto end;
+            }
+            continue;
+        }
+        /* value is complete, close the containers it ends or go on to the next member */
+        for (;;) {
+            if (stack.count == 0) {
+                status = JSONSuccess;
+                goto end;
+            }
+            container = json_value_get_parent(value);
+            index = ++stack.items[stack.count - 1];
+            if (index < json_value_get_member_count(container)) {
+                value = cbor_write_member_start(container, index, writer);
+                if (value == NULL) {
+                    goto end;
+                }
+                break;
+            }
+            stack.count--;
+            value = container;
+        }
+    }
+end:
+    index_stack_free(&stack);
+    return status;
+}
+
+/* Reads the head of a data item, indefinite lengths are not supported */
+static JSON_Status cbor_read_head(const unsigned char **data, const unsigned char *end,
+                                  unsigned int *major, unsigned int *info, uint64_t *argument)
+{
+    const unsigned char *ptr = *data;
+    size_t size = 0, i = 0;
+    if (ptr >= end) {
+        return JSONFailure;
+    }
+    *major = *ptr >> 5;
+    *info = *ptr & 0x1f;
+    *argument = *info;
+    ptr++;
+    if (*info > CBOR_DOUBLE) {
+        return JSONFailure;
+    }
+    if (*info >= 24) {
+        size = (size_t)1 << (*info - 24);
+        if ((size_t)(end - ptr) < size) {
+            return JSONFailure;
+        }
+        *argument = 0;
+        for (i = 0; i < size; i++) {
+            *argument = (*argument << 8) | ptr[i];
+        }
+        ptr += size;
+    }
+    *data = ptr;
+    return JSONSuccess;
+}
+
+static double cbor_half_to_double(unsigned int half)
+{
+    unsigned int exponent = (half >> 10) & 0x1f, mantissa = half & 0x3ff;
+    double number = 0;
+    if (exponent == 0) {
+        number = ldexp((double)mantissa, -24);
+    } else if (exponent != 31) {
+        number = ldexp((double)(mantissa + 1024), (int)exponent - 25);
+    } else {
+        number = HUGE_VAL; /* rejected like inf and nan */
+    }
+    return (half & 0x8000) ? -number : number;
+}
+
+/* Text strings are UTF-8 without '\0', which names and strings end at, as for parsed text */
+static int cbor_is_valid_text(const unsigned char *data, size_t length)
+{
+    return memchr(data, '\0', length) == NULL && is_valid_utf8((const char *)data, length);
+}
+
+/* Parses a data item. Containers are returned empty, with room for the count members declared. */
+static JSON_Value *cbor_parse_item(const unsigned char **data, const unsigned char *end,
+                                   size_t nesting, size_t *count)
+{
+    JSON_Value *value = NULL;
+    JSON_Object *object = NULL;
+    JSON_Array *array = NULL;
+    unsigned int major = 0, info = 0;
+    uint64_t argument = 0;
+    uint32_t single_bits = 0;
+    float single = 0;
+    double number = 0;
+    do { /* tags are skipped */
+        if (cbor_read_head(data, end, &major, &info, &argument) == JSONFailure) {
+            return NULL;
+        }
+    } while (major == CBOR_TAG);
+    switch (major) {
+    case CBOR_UNSIGNED:
+        return json_value_init_number((double)argument);
+    case CBOR_NEGATIVE:
+        return json_value_init_number(-1.0 - (double)argument);
+    case CBOR_TEXT:
+        if (argument > (uint64_t)(end - *data) ||
+            !cbor_is_valid_text(*data, (size_t)argument)) {
+            return NULL;
+        }
+        value = json_value_init_string_copy(NULL, (const char *)*data, (size_t)argument);
+        *data += argument;
+        return value;
+    case CBOR_ARRAY:
+        if (nesting >= parson_nesting_limit ||
+            argument > (uint64_t)(end - *data)) { /* every item takes a byte at least */
+            return NULL;
+        }
+        value = json_value_init_array();
+        array = json_value_get_array(value);
+        if (value == NULL || (argument > 0 && json_array_resize(array, (size_t)argument) ==
+                                                  JSONFailure)) {
+            json_value_free(value);
+            return NULL;
+        }
+        *count = (size_t)argument;
+        return value;
+    case CBOR_MAP:
+        if (nesting >= parson_nesting_limit ||
+            argument > (uint64_t)(end - *data) / 2) { /* every member takes two bytes at least */
+            return NULL;
+        }
+        value = json_value_init_object();
+        object = json_value_get_object(value);
+        if (value == NULL || (argument > 0 && json_object_resize(object, (size_t)argument) ==
+                                                  JSONFailure)) {
+            json_value_free(value);
+            return NULL;
+        }
+        *count = (size_t)argument;
+        return value;
+    case CBOR_SIMPLE:
+        switch (info) {
+        case CBOR_FALSE:
+            return json_value_init_boolean(0);
+        case CBOR_TRUE:
+            return json_value_init_boolean(1);
+        case CBOR_NULL:
+            return json_value_init_null();
+        case CBOR_HALF:
+            return json_value_init_number(cbor_half_to_double((unsigned int)argument));
+        case CBOR_SINGLE:
+            single_bits = (uint32_t)argument;
+            memcpy(&single, &single_bits, sizeof(float));
+            return json_value_init_number((double)single);
+        case CBOR_DOUBLE:
+            memcpy(&number, &argument, sizeof(double));
+            return json_value_init_number(number); /* fails on nan and inf */
+        default: /* undefined and unassigned simple values */
+            return NULL;
+        }
+    default: /* byte strings */
+        return NULL;
+    }
+}
+
+/* Reads the name of a member of object, returns NULL on failure */
+static char *cbor_parse_name(const unsigned char **data, const unsigned char *end,
+                             JSON_Object *object, size_t *length)
+{
+    unsigned int major = 0, info = 0;
+    uint64_t argument = 0;
+    char *name = NULL;
+    if (cbor_read_head(data, end, &major, &info, &argument) == JSONFailure ||
+        major != CBOR_TEXT || argument > (uint64_t)(end - *data) ||
+        !cbor_is_valid_text(*data, (size_t)argument)) {
+        return NULL;
+    }
+    name = json_object_copy_name(object, (const char *)*data, (size_t)argument);
+    *data += argument;
+    *length = (size_t)argument;
+    return name;
+}
+
+/* Parses without recursion, like parse_value: containers are attached as soon as they are opened
+   and the number of members declared by every open container is kept. */
+static JSON_Value *cbor_parse_value(const unsigned char **data, const unsigned char *end)
+{
+    JSON_Index_Stack counts; /* number of members declared by every open container */
+    JSON_Value *root = NULL, *container = NULL, *value = NULL;
+    JSON_Object *object = NULL; /* object of container, NULL when it is an array */
+    char *name = NULL;          /* name of the next member of object */
+    size_t name_length = 0, count = 0;
+    index_stack_init(&counts);
+    for (;;) {
+        if (object != NULL) {
+            name = cbor_parse_name(data, end, object, &name_length);
+            if (name == NULL) {
+                goto error;
+            }
+        }
+        count = 0;
+        value = cbor_parse_item(data, end, counts.count, &count);
+        if (value == NULL) {
+            goto error;
+        }
+        if (container == NULL) {
+            root = value;
+        } else if ((object != NULL ?
+                        json_object_append_unique(object, name, name_length, value) :
+                        json_array_add(json_value_get_array(container), value)) == JSONFailure) {
+            json_value_free(value);
+            goto error;
+        }
+        name = NULL;
+        if (count > 0) {
+            if (index_stack_push(&counts, count) == JSONFailure) {
+                goto error;
+            }
+            container = value;
+            object = json_value_get_object(container);
+            continue;
+        }
+        /* value is complete, close the containers it fills */
+        while (container != NULL &&
+               json_value_get_member_count(container) == counts.items[counts.count - 1]) {
+            counts.count--;
+            container = counts.count > 0 ? json_value_get_parent(container) : NULL;
+            object = json_value_get_object(container);
+        }
+        if (container == NULL) {
+            index_stack_free(&counts);
+            return root;
+        }
+    }
+error:
+    if (name != NULL) {
+        json_object_free_name(object, name);
+    }
+    index_stack_free(&counts);
+    json_value_free(root);
+    return NULL;
+}
+
+/* Parser API */
+static JSON_Value *parse_root(const char *string, size_t length, JSON_Arena *arena, int insitu)
+{
+    JSON_Parser parser;
+    JSON_Index_Stack member_counts;
+    JSON_Value *value = NULL;
+    if (string == NULL) {
+        return NULL;
+    }
+    if (length >= 3 && string[0] == '\xEF' && string[1] == '\xBB' && string[2] == '\xBF') {
+        string = string + 3; /* Support for UTF-8 BOM */
+        length -= 3;
+    }
+    index_stack_init(&member_counts);
+    if (length < COUNT_MEMBERS_MIN_LENGTH ||
+        count_members(string, string + length, &member_counts) == JSONSuccess) {
+        parser.arena = arena;
+        parser.insitu = insitu;
+        parser.end = string + length;
+        parser.member_counts = &member_counts;
+        parser.next_container = 0;
+        value = parse_value((const char **)&string, &parser);
+    }
+    index_stack_free(&member_counts);
+    return value;
+}
+
+JSON_Value *json_parse_string(const char *string)
+{
+    if (string == NULL) {
+        return NULL;
+    }
+    return parse_root(string, strlen(string), NULL, 0);
+}
+
+JSON_Value *json_parse_string_arena(JSON_Arena *arena, const char *string)
+{
+    if (string == NULL) {
+        return NULL;
+    }
+    return parse_root(string, strlen(string), arena, 0);
+}
+
+JSON_Value *json_parse_string_insitu(char *string)
+{
+    return json_parse_string_insitu_arena(NULL, string);
+}
+
+JSON_Value *json_parse_string_insitu_arena(JSON_Arena *arena, char *string)
+{
+    if (string == NULL) {
+        return NULL;
+    }
+    return parse_root(string, strlen(string), arena, 1);
+}
+
+JSON_Value *json_parse_string_with_comments(const char *string)
+{
+    if (string == NULL) {
+        return NULL;
+    }
+    return json_parse_buffer_with_comments(string, strlen(string));
+}
+
+JSON_Value *json_parse_buffer(const char *data, size_t length)
+{
+    return parse_root(data, length, NULL, 0);
+}
+
+JSON_Value *json_parse_buffer_arena(JSON_Arena *arena, const char *data, size_t length)
+{
+    return parse_root(data, length, arena, 0);
+}
+
+JSON_Value *json_parse_buffer_with_comments(const char *data, size_t length)
+{
+    JSON_Value *result = NULL;
+    char *data_mutable_copy = NULL;
+    if (data == NULL) {
+        return NULL;
+    }
+    data_mutable_copy = parson_strndup(data, length);
+    if (data_mutable_copy == NULL) {
+        return NULL;
+    }
+    remove_comments(data_mutable_copy, "/*", "*/");
+    remove_comments(data_mutable_copy, "//", "\n");
+    result = parse_root(data_mutable_copy, length, NULL, 0);
+    parson_free(data_mutable_copy);
+    return result;
+}
+
+JSON_Value *json_parse_string_lazy(const char *string)
+{
+    if (string == NULL) {
+        return NULL;
+    }
+    return json_parse_buffer_lazy(string, strlen(string));
+}
+
+/* Only builds the tape, containers are parsed by lazy_materialize when first reached */
+JSON_Value *json_parse_buffer_lazy(const char *data, size_t length)
+{
+    JSON_Tape *tape = NULL;
+    JSON_Value *value = NULL;
+    const char *start = NULL;
+    if (data == NULL) {
+        return NULL;
     }
-    APPEND_STRING("\"");
-    return written_total;
+    if (length >= 3 && data[0] == '\xEF' && data[1] == '\xBB' && data[2] == '\xBF') {
+        data = data + 3; /* Support for UTF-8 BOM */
+        length -= 3;
+    }
+    start = skip_whitespaces(data, data + length);
+    if (start == data + length || (*start != '{' && *start != '[')) {
+        return parse_root(data, length, NULL, 0); /* a scalar has nothing to defer */
+    }
+    tape = (JSON_Tape *)parson_malloc(sizeof(JSON_Tape));
+    if (tape == NULL) {
+        return NULL;
+    }
+    tape->text = parson_strndup(data, length);
+    tape->entries = NULL;
+    tape->count = 0;
+    tape->capacity = 0;
+    tape->refs = 1; /* held until the root points at it */
+    if (tape->text != NULL &&
+        tape_build(tape, tape->text + (start - data), tape->text + length) == JSONSuccess) {
+        value = lazy_value_init(tape, 0);
+    }
+    tape_release(tape);
+    return value;
 }
 
-static int append_indent(char *buf, int level)
+/* Event parser API */
+JSON_Status json_parse_events(const char *data, size_t length, JSON_Event_Handler handler,
+                              void *context)
 {
-    int i;
-    int written = -1, written_total = 0;
-    for (i = 0; i < level; i++) {
-        APPEND_STRING("    ");
+    JSON_Event_Parser parser;
+    if (data == NULL || handler == NULL) {
+        return JSONFailure;
+    }
+    if (length >= 3 && data[0] == '\xEF' && data[1] == '\xBB' && data[2] == '\xBF') {
+        data = data + 3; /* Support for UTF-8 BOM */
+        length -= 3;
+    }
+    parser.handler = handler;
+    parser.context = context;
+    parser.end = data + length;
+    parser.stopped = 0;
+    if (parse_events(&data, &parser) == JSONFailure && !parser.stopped) {
+        return JSONFailure;
     }
-    return written_total;
+    return JSONSuccess;
 }
 
-static int append_string(char *buf, const char *string)
+JSON_Status json_event_get_string(const JSON_Event *event, char *buf, size_t buf_size_in_bytes)
 {
-    if (buf == NULL) {
-        return (int)strlen(string);
+    if (event == NULL || buf == NULL || buf_size_in_bytes < event->length + 1 ||
+        (event->type != JSONEventKey && event->type != JSONEventString)) {
+        return JSONFailure;
     }
-    return sprintf(buf, "%s", string);
+    return unescape_string(event->string, event->length, buf, NULL);
 }
 
-#undef APPEND_STRING
-#undef APPEND_INDENT
-
-/* Parser API */
-JSON_Value *json_parse_string(const char *string)
+/* Incremental parser API */
+JSON_Stream *json_stream_create(void)
 {
-    if (string == NULL) {
+    JSON_Stream *stream = (JSON_Stream *)parson_malloc(sizeof(JSON_Stream));
+    if (stream == NULL) {
         return NULL;
     }
-    if (string[0] == '\xEF' && string[1] == '\xBB' && string[2] == '\xBF') {
-        string = string + 3; /* Support for UTF-8 BOM */
+    memset(stream, 0, sizeof(JSON_Stream));
+    stream->state = STREAM_VALUE;
+    return stream;
+}
+
+JSON_Stream_Status json_stream_feed(JSON_Stream *stream, const char *data, size_t length,
+                                    size_t *consumed)
+{
+    const char *ptr = data, *end = data + length;
+    if (consumed != NULL) {
+        *consumed = 0;
+    }
+    if (stream == NULL || (data == NULL && length > 0)) {
+        return JSONStreamError;
+    }
+    while (ptr < end && stream->state != STREAM_COMPLETE && stream->state != STREAM_ERROR) {
+        ptr = stream_step(stream, ptr, end);
+    }
+    if (consumed != NULL) {
+        *consumed = (size_t)(ptr - data);
     }
-    return parse_value((const char **)&string, 0);
+    if (stream->state == STREAM_COMPLETE) {
+        return JSONStreamComplete;
+    }
+    return stream->state == STREAM_ERROR ? JSONStreamError : JSONStreamIncomplete;
 }
 
-JSON_Value *json_parse_string_with_comments(const char *string)
+JSON_Value *json_stream_take_value(JSON_Stream *stream)
 {
-    JSON_Value *result = NULL;
-    char *string_mutable_copy = NULL, *string_mutable_copy_ptr = NULL;
-    string_mutable_copy = parson_strdup(string);
-    if (string_mutable_copy == NULL) {
+    JSON_Value *value = NULL;
+    if (stream == NULL || stream->state != STREAM_COMPLETE) {
         return NULL;
     }
-    remove_comments(string_mutable_copy, "/*", "*/");
-    remove_comments(string_mutable_copy, "//", "\n");
-    string_mutable_copy_ptr = string_mutable_copy;
-    result = parse_value((const char **)&string_mutable_copy_ptr, 0);
-    parson_free(string_mutable_copy);
-    return result;
+    value = stream->root;
+    stream->root = NULL;
+    stream->state = STREAM_VALUE;
+    return value;
+}
+
+void json_stream_reset(JSON_Stream *stream)
+{
+    if (stream == NULL) {
+        return;
+    }
+    stream_fail(stream);
+    stream->state = STREAM_VALUE;
+}
+
+void json_stream_free(JSON_Stream *stream)
+{
+    if (stream == NULL) {
+        return;
+    }
+    json_stream_reset(stream);
+    parson_free(stream->frames);
+    parson_free(stream->token);
+    parson_free(stream);
+}
+
+/* Decoding API */
+JSON_Status json_decode_buffer(const char *data, size_t length, const JSON_Field *fields,
+                               size_t field_count, void *target, JSON_Field_Status *statuses)
+{
+    JSON_Decoder decoder;
+    size_t i;
+    if (fields == NULL || target == NULL || statuses == NULL) {
+        return JSONFailure;
+    }
+    for (i = 0; i < field_count; i++) {
+        if (fields[i].path == NULL) {
+            return JSONFailure;
+        }
+        statuses[i] = JSONFieldMissing;
+    }
+    decoder.fields = fields;
+    decoder.field_count = field_count;
+    decoder.target = (char *)target;
+    decoder.statuses = statuses;
+    decoder.names[0] = NULL;
+    if (json_parse_events(data, length, decoder_handle_event, &decoder) == JSONFailure) {
+        for (i = 0; i < field_count; i++) {
+            statuses[i] = JSONFieldInvalid; /* values before the error cannot be trusted */
+        }
+        return JSONFailure;
+    }
+    for (i = 0; i < field_count; i++) {
+        if (statuses[i] != JSONFieldDecoded) {
+            return JSONFailure;
+        }
+    }
+    return JSONSuccess;
 }
 
 /* JSON Object API */
@@ -1312,6 +4379,95 @@ int json_object_dotget_boolean(const JSON_Object *object, const char *name)
     return json_value_get_boolean(json_object_dotget_value(object, name));
 }
 
+JSON_Path *json_path_compile(const char *name)
+{
+    JSON_Path *path = NULL;
+    JSON_Path_Segment *segment = NULL;
+    size_t count = 1, name_len = 0;
+    char *name_copy = NULL;
+    const char *segment_start = NULL, *dot_position = NULL;
+    if (name == NULL) {
+        return NULL;
+    }
+    name_len = strlen(name);
+    for (dot_position = strchr(name, '.'); dot_position != NULL;
+         dot_position = strchr(dot_position + 1, '.')) {
+        count++;
+    }
+    path = (JSON_Path *)parson_malloc(sizeof(JSON_Path) + count * sizeof(JSON_Path_Segment) +
+                                      name_len + 1);
+    if (path == NULL) {
+        return NULL;
+    }
+    path->count = count;
+    path->segments = (JSON_Path_Segment *)(path + 1);
+    name_copy = (char *)(path->segments + count);
+    memcpy(name_copy, name, name_len + 1);
+    segment_start = name_copy;
+    for (segment = path->segments; segment < path->segments + count; segment++) {
+        dot_position = strchr(segment_start, '.');
+        segment->name = segment_start;
+        segment->length = dot_position != NULL ? (size_t)(dot_position - segment_start)
+                                               : strlen(segment_start);
+        segment->hash = hash_string(segment->name, segment->length);
+        segment_start += segment->length + 1;
+    }
+    return path;
+}
+
+void json_path_free(JSON_Path *path)
+{
+    parson_free(path);
+}
+
+JSON_Value *json_path_get_value(const JSON_Object *object, const JSON_Path *path)
+{
+    JSON_Value *value = NULL;
+    const JSON_Path_Segment *segment = NULL;
+    size_t index;
+    if (path == NULL) {
+        return NULL;
+    }
+    for (segment = path->segments; segment < path->segments + path->count; segment++) {
+        if (object == NULL) {
+            return NULL;
+        }
+        index = json_object_getn_index_hashed(object, segment->name, segment->length,
+                                              segment->hash);
+        if (index == OBJECT_INDEX_NOT_FOUND) {
+            return NULL;
+        }
+        value = object->values[index];
+        object = json_value_get_object(value);
+    }
+    return value;
+}
+
+const char *json_path_get_string(const JSON_Object *object, const JSON_Path *path)
+{
+    return json_value_get_string(json_path_get_value(object, path));
+}
+
+double json_path_get_number(const JSON_Object *object, const JSON_Path *path)
+{
+    return json_value_get_number(json_path_get_value(object, path));
+}
+
+JSON_Object *json_path_get_object(const JSON_Object *object, const JSON_Path *path)
+{
+    return json_value_get_object(json_path_get_value(object, path));
+}
+
+JSON_Array *json_path_get_array(const JSON_Object *object, const JSON_Path *path)
+{
+    return json_value_get_array(json_path_get_value(object, path));
+}
+
+int json_path_get_boolean(const JSON_Object *object, const JSON_Path *path)
+{
+    return json_value_get_boolean(json_path_get_value(object, path));
+}
+
 size_t json_object_get_count(const JSON_Object *object)
 {
     return object ? object->count : 0;
@@ -1411,29 +4567,72 @@ JSON_Value_Type json_value_get_type(const JSON_Value *value)
     return value ? value->type : JSONError;
 }
 
+/* Containers of lazily parsed documents are parsed here, when first reached */
 JSON_Object *json_value_get_object(const JSON_Value *value)
 {
-    return json_value_get_type(value) == JSONObject ? value->value.object : NULL;
+    if (json_value_get_type(value) != JSONObject) {
+        return NULL;
+    }
+    if ((value->flags & VALUE_FLAG_LAZY) && lazy_materialize((JSON_Value *)value) == JSONFailure) {
+        return NULL;
+    }
+    return json_value_get_payload(value).object;
 }
 
 JSON_Array *json_value_get_array(const JSON_Value *value)
 {
-    return json_value_get_type(value) == JSONArray ? value->value.array : NULL;
+    if (json_value_get_type(value) != JSONArray) {
+        return NULL;
+    }
+    if ((value->flags & VALUE_FLAG_LAZY) && lazy_materialize((JSON_Value *)value) == JSONFailure) {
+        return NULL;
+    }
+    return json_value_get_payload(value).array;
 }
 
 const char *json_value_get_string(const JSON_Value *value)
 {
-    return json_value_get_type(value) == JSONString ? value->value.string : NULL;
+    if (json_value_get_type(value) != JSONString) {
+        return NULL;
+    }
+    if (value->flags & VALUE_FLAG_INLINE) {
+        return value->payload;
+    }
+    return json_value_get_payload(value).string;
 }
 
 double json_value_get_number(const JSON_Value *value)
 {
-    return json_value_get_type(value) == JSONNumber ? value->value.number : 0;
+    return json_value_get_type(value) == JSONNumber ? json_value_get_payload(value).number : 0;
 }
 
 int json_value_get_boolean(const JSON_Value *value)
 {
-    return json_value_get_type(value) == JSONBoolean ? value->value.boolean : -1;
+    return json_value_get_type(value) == JSONBoolean ? json_value_get_payload(value).boolean : -1;
+}
+
+/* The decimals are stored in the payload right after the number */
+int json_value_get_number_decimals(const JSON_Value *value)
+{
+    if (json_value_get_type(value) != JSONNumber || !(value->flags & VALUE_FLAG_FIXED)) {
+        return -1;
+    }
+    return (unsigned char)value->payload[sizeof(double)];
+}
+
+JSON_Status json_value_set_number_decimals(JSON_Value *value, int decimals)
+{
+    if (json_value_get_type(value) != JSONNumber || decimals < -1 ||
+        decimals > NUMBER_DECIMALS_MAX) {
+        return JSONFailure;
+    }
+    if (decimals == -1) {
+        value->flags &= ~VALUE_FLAG_FIXED;
+        return JSONSuccess;
+    }
+    value->payload[sizeof(double)] = (char)decimals;
+    value->flags |= VALUE_FLAG_FIXED;
+    return JSONSuccess;
 }
 
 JSON_Value *json_value_get_parent(const JSON_Value *value)
@@ -1441,60 +4640,116 @@ JSON_Value *json_value_get_parent(const JSON_Value *value)
     return value ? value->parent : NULL;
 }
 
+/* Frees without recursion: the last member of a container is detached and freed first, going
+   down through containers and back up through parents */
 void json_value_free(JSON_Value *value)
 {
-    switch (json_value_get_type(value)) {
-    case JSONObject:
-        json_object_free(value->value.object);
-        break;
-    case JSONString:
-        parson_free(value->value.string);
-        break;
-    case JSONArray:
-        json_array_free(value->value.array);
-        break;
-    default:
-        break;
+    JSON_Value *root = value, *member = NULL, *parent = NULL;
+    JSON_Object *object = NULL;
+    JSON_Array *array = NULL;
+    size_t tape_index = 0;
+    int lazy = 0;
+    if (value == NULL || (value->flags & VALUE_FLAG_ARENA)) {
+        return; /* arena values are released with the whole arena */
+    }
+    for (;;) {
+        member = NULL;
+        lazy = (value->flags & VALUE_FLAG_LAZY) != 0; /* has no members, not parsing them */
+        object = lazy ? NULL : json_value_get_object(value);
+        array = lazy ? NULL : json_value_get_array(value);
+        if (object != NULL && object->count > 0) {
+            object->count--;
+            json_object_free_name(object, object->names[object->count]);
+            member = object->values[object->count];
+        } else if (array != NULL && array->count > 0) {
+            array->count--;
+            member = array->items[array->count];
+        }
+        if (member != NULL) {
+            if (!(member->flags & VALUE_FLAG_ARENA)) {
+                value = member;
+            }
+            continue;
+        }
+        /* value has no members left */
+        parent = value == root ? NULL : value->parent;
+        if (object != NULL) {
+            json_object_free(object);
+        } else if (array != NULL) {
+            json_array_free(array);
+        } else if (lazy) {
+            tape_release(lazy_value_get_tape(value, &tape_index));
+        } else if (json_value_get_type(value) == JSONString &&
+                   !(value->flags & (VALUE_FLAG_BORROWED | VALUE_FLAG_INLINE))) {
+            parson_free(json_value_get_payload(value).string);
+        }
+        parson_free(value);
+        if (parent == NULL) {
+            return;
+        }
+        value = parent;
     }
-    parson_free(value);
 }
 
-JSON_Value *json_value_init_object(void)
+JSON_Status json_value_shrink_to_fit(JSON_Value *value)
 {
-    JSON_Value *new_value = (JSON_Value *)parson_malloc(sizeof(JSON_Value));
-    if (!new_value) {
-        return NULL;
+    JSON_Index_Stack stack;
+    JSON_Value *container = NULL;
+    JSON_Status status = JSONFailure;
+    size_t index = 0;
+    if (value == NULL) {
+        return JSONFailure;
     }
-    new_value->parent = NULL;
-    new_value->type = JSONObject;
-    new_value->value.object = json_object_init(new_value);
-    if (!new_value->value.object) {
-        parson_free(new_value);
-        return NULL;
+    index_stack_init(&stack);
+    for (;;) { /* visits every value once, without recursion, like json_serialize_value */
+        if (value->flags & VALUE_FLAG_LAZY) {
+            /* unparsed containers have nothing to shrink */
+        } else if (!(value->flags & VALUE_FLAG_ARENA) &&
+            ((json_value_get_type(value) == JSONObject &&
+              json_object_shrink(json_value_get_object(value)) == JSONFailure) ||
+             (json_value_get_type(value) == JSONArray &&
+              json_array_shrink(json_value_get_array(value)) == JSONFailure))) {
+            goto end;
+        }
+        if (!(value->flags & VALUE_FLAG_LAZY) && json_value_get_member_count(value) > 0) {
+            if (index_stack_push(&stack, 0) == JSONFailure) {
+                goto end;
+            }
+            value = json_value_get_member_at(value, 0);
+            continue;
+        }
+        for (;;) {
+            if (stack.count == 0) {
+                status = JSONSuccess;
+                goto end;
+            }
+            container = json_value_get_parent(value);
+            index = ++stack.items[stack.count - 1];
+            if (index < json_value_get_member_count(container)) {
+                value = json_value_get_member_at(container, index);
+                break;
+            }
+            stack.count--;
+            value = container;
+        }
     }
-    return new_value;
+end:
+    index_stack_free(&stack);
+    return status;
+}
+
+JSON_Value *json_value_init_object(void)
+{
+    return json_value_init_object_arena(NULL);
 }
 
 JSON_Value *json_value_init_array(void)
 {
-    JSON_Value *new_value = (JSON_Value *)parson_malloc(sizeof(JSON_Value));
-    if (!new_value) {
-        return NULL;
-    }
-    new_value->parent = NULL;
-    new_value->type = JSONArray;
-    new_value->value.array = json_array_init(new_value);
-    if (!new_value->value.array) {
-        parson_free(new_value);
-        return NULL;
-    }
-    return new_value;
+    return json_value_init_array_arena(NULL);
 }
 
 JSON_Value *json_value_init_string(const char *string)
 {
-    char *copy = NULL;
-    JSON_Value *value;
     size_t string_len = 0;
     if (string == NULL) {
         return NULL;
@@ -1503,54 +4758,35 @@ JSON_Value *json_value_init_string(const char *string)
     if (!is_valid_utf8(string, string_len)) {
         return NULL;
     }
-    copy = parson_strndup(string, string_len);
-    if (copy == NULL) {
-        return NULL;
-    }
-    value = json_value_init_string_no_copy(copy);
-    if (value == NULL) {
-        parson_free(copy);
-    }
-    return value;
+    return json_value_init_string_copy(NULL, string, string_len);
 }
 
 JSON_Value *json_value_init_number(double number)
 {
-    JSON_Value *new_value = NULL;
-    if ((number * 0.0) != 0.0) { /* nan and inf test */
+    return json_value_init_number_arena(NULL, number);
+}
+
+JSON_Value *json_value_init_number_fixed(double number, int decimals)
+{
+    JSON_Value *value = json_value_init_number(number);
+    if (value == NULL) {
         return NULL;
     }
-    new_value = (JSON_Value *)parson_malloc(sizeof(JSON_Value));
-    if (new_value == NULL) {
+    if (json_value_set_number_decimals(value, decimals) == JSONFailure) {
+        json_value_free(value);
         return NULL;
     }
-    new_value->parent = NULL;
-    new_value->type = JSONNumber;
-    new_value->value.number = number;
-    return new_value;
+    return value;
 }
 
 JSON_Value *json_value_init_boolean(int boolean)
 {
-    JSON_Value *new_value = (JSON_Value *)parson_malloc(sizeof(JSON_Value));
-    if (!new_value) {
-        return NULL;
-    }
-    new_value->parent = NULL;
-    new_value->type = JSONBoolean;
-    new_value->value.boolean = boolean ? 1 : 0;
-    return new_value;
+    return json_value_init_boolean_arena(NULL, boolean);
 }
 
 JSON_Value *json_value_init_null(void)
 {
-    JSON_Value *new_value = (JSON_Value *)parson_malloc(sizeof(JSON_Value));
-    if (!new_value) {
-        return NULL;
-    }
-    new_value->parent = NULL;
-    new_value->type = JSONNull;
-    return new_value;
+    return json_value_init_null_arena(NULL);
 }
 
 JSON_Value *json_value_deep_copy(const JSON_Value *value)
@@ -1558,7 +4794,6 @@ JSON_Value *json_value_deep_copy(const JSON_Value *value)
     size_t i = 0;
     JSON_Value *return_value = NULL, *temp_value_copy = NULL, *temp_value = NULL;
     const char *temp_string = NULL, *temp_key = NULL;
-    char *temp_string_copy = NULL;
     JSON_Array *temp_array = NULL, *temp_array_copy = NULL;
     JSON_Object *temp_object = NULL, *temp_object_copy = NULL;
 
@@ -1593,7 +4828,7 @@ JSON_Value *json_value_deep_copy(const JSON_Value *value)
         temp_object_copy = json_value_get_object(return_value);
         for (i = 0; i < json_object_get_count(temp_object); i++) {
             temp_key = json_object_get_name(temp_object, i);
-            temp_value = json_object_get_value(temp_object, temp_key);
+            temp_value = json_object_get_value_at(temp_object, i);
             temp_value_copy = json_value_deep_copy(temp_value);
             if (temp_value_copy == NULL) {
                 json_value_free(return_value);
@@ -1609,118 +4844,233 @@ JSON_Value *json_value_deep_copy(const JSON_Value *value)
     case JSONBoolean:
         return json_value_init_boolean(json_value_get_boolean(value));
     case JSONNumber:
-        return json_value_init_number(json_value_get_number(value));
+        return json_value_init_number_fixed(json_value_get_number(value),
+                                            json_value_get_number_decimals(value));
     case JSONString:
         temp_string = json_value_get_string(value);
         if (temp_string == NULL) {
             return NULL;
         }
-        temp_string_copy = parson_strdup(temp_string);
-        if (temp_string_copy == NULL) {
-            return NULL;
-        }
-        return_value = json_value_init_string_no_copy(temp_string_copy);
-        if (return_value == NULL) {
-            parson_free(temp_string_copy);
-        }
-        return return_value;
+        return json_value_init_string_copy(NULL, temp_string, strlen(temp_string));
     case JSONNull:
         return json_value_init_null();
     case JSONError:
         return NULL;
-    default:
+    default:
+        return NULL;
+    }
+}
+
+size_t json_serialization_size(const JSON_Value *value)
+{
+    JSON_Writer writer;
+    writer_init(&writer, NULL, 0, 0);
+    if (json_serialize_value(value, &writer, 0) == JSONFailure) {
+        return 0;
+    }
+    return writer.length + 1;
+}
+
+JSON_Status json_serialize_to_buffer(const JSON_Value *value, char *buf, size_t buf_size_in_bytes)
+{
+    JSON_Writer writer;
+    if (buf == NULL) {
+        return JSONFailure;
+    }
+    writer_init(&writer, buf, buf_size_in_bytes, 0);
+    if (json_serialize_value(value, &writer, 0) == JSONFailure) {
+        return JSONFailure;
+    }
+    writer_terminate(&writer);
+    return JSONSuccess;
+}
+
+char *json_serialize_to_string(const JSON_Value *value)
+{
+    JSON_Writer writer;
+    writer_init(&writer, NULL, 0, 1);
+    if (json_serialize_value(value, &writer, 0) == JSONFailure ||
+        writer_reserve(&writer, 0) == JSONFailure) { /* empty writers have no buffer yet */
+        parson_free(writer.buf);
+        return NULL;
+    }
+    writer_terminate(&writer);
+    return writer.buf;
+}
+
+JSON_Status json_serialize_to_sink(const JSON_Value *value, JSON_Sink_Function sink,
+                                   void *context)
+{
+    return serialize_to_sink(value, sink, context, 0);
+}
+
+size_t json_serialization_size_pretty(const JSON_Value *value)
+{
+    JSON_Writer writer;
+    writer_init(&writer, NULL, 0, 0);
+    if (json_serialize_value(value, &writer, 1) == JSONFailure) {
+        return 0;
+    }
+    return writer.length + 1;
+}
+
+JSON_Status json_serialize_to_buffer_pretty(const JSON_Value *value, char *buf,
+                                            size_t buf_size_in_bytes)
+{
+    JSON_Writer writer;
+    if (buf == NULL) {
+        return JSONFailure;
+    }
+    writer_init(&writer, buf, buf_size_in_bytes, 0);
+    if (json_serialize_value(value, &writer, 1) == JSONFailure) {
+        return JSONFailure;
+    }
+    writer_terminate(&writer);
+    return JSONSuccess;
+}
+
+char *json_serialize_to_string_pretty(const JSON_Value *value)
+{
+    JSON_Writer writer;
+    writer_init(&writer, NULL, 0, 1);
+    if (json_serialize_value(value, &writer, 1) == JSONFailure ||
+        writer_reserve(&writer, 0) == JSONFailure) { /* empty writers have no buffer yet */
+        parson_free(writer.buf);
+        return NULL;
+    }
+    writer_terminate(&writer);
+    return writer.buf;
+}
+
+JSON_Status json_serialize_to_sink_pretty(const JSON_Value *value, JSON_Sink_Function sink,
+                                          void *context)
+{
+    return serialize_to_sink(value, sink, context, 1);
+}
+
+void json_free_serialized_string(char *string)
+{
+    parson_free(string);
+}
+
+/* Writers */
+JSON_Writer *json_writer_create(size_t initial_capacity)
+{
+    JSON_Writer *writer = (JSON_Writer *)parson_malloc(sizeof(JSON_Writer));
+    if (writer == NULL) {
+        return NULL;
+    }
+    writer_init(writer, NULL, 0, 1);
+    if (initial_capacity > 0 && writer_reserve(writer, initial_capacity - 1) == JSONFailure) {
+        parson_free(writer);
         return NULL;
     }
+    return writer;
 }
 
-size_t json_serialization_size(const JSON_Value *value)
+JSON_Status json_writer_serialize(JSON_Writer *writer, const JSON_Value *value)
 {
-    char num_buf[NUM_BUF_SIZE]; /* recursively allocating buffer on stack is a bad idea, so let's do
-                                   it only once */
-    int res = json_serialize_to_buffer_r(value, NULL, 0, 0, num_buf);
-    return res < 0 ? 0 : (size_t)(res + 1);
+    if (writer == NULL) {
+        return JSONFailure;
+    }
+    writer->length = 0;
+    if (json_serialize_value(value, writer, 0) == JSONFailure ||
+        writer_reserve(writer, 0) == JSONFailure) {
+        writer->length = 0;
+        return JSONFailure;
+    }
+    writer_terminate(writer);
+    return JSONSuccess;
 }
 
-JSON_Status json_serialize_to_buffer(const JSON_Value *value, char *buf, size_t buf_size_in_bytes)
+JSON_Status json_writer_serialize_pretty(JSON_Writer *writer, const JSON_Value *value)
 {
-    int written = -1;
-    size_t needed_size_in_bytes = json_serialization_size(value);
-    if (needed_size_in_bytes == 0 || buf_size_in_bytes < needed_size_in_bytes) {
+    if (writer == NULL) {
         return JSONFailure;
     }
-    written = json_serialize_to_buffer_r(value, buf, 0, 0, NULL);
-    if (written < 0) {
+    writer->length = 0;
+    if (json_serialize_value(value, writer, 1) == JSONFailure ||
+        writer_reserve(writer, 0) == JSONFailure) {
+        writer->length = 0;
         return JSONFailure;
     }
+    writer_terminate(writer);
     return JSONSuccess;
 }
 
-char *json_serialize_to_string(const JSON_Value *value)
+const char *json_writer_get_string(const JSON_Writer *writer)
 {
-    JSON_Status serialization_result = JSONFailure;
-    size_t buf_size_bytes = json_serialization_size(value);
-    char *buf = NULL;
-    if (buf_size_bytes == 0) {
-        return NULL;
+    if (writer == NULL || writer->buf == NULL) {
+        return "";
     }
-    buf = (char *)parson_malloc(buf_size_bytes);
-    if (buf == NULL) {
-        return NULL;
+    return writer->buf;
+}
+
+size_t json_writer_get_length(const JSON_Writer *writer)
+{
+    return writer == NULL ? 0 : writer->length;
+}
+
+void json_writer_free(JSON_Writer *writer)
+{
+    if (writer == NULL) {
+        return;
     }
-    serialization_result = json_serialize_to_buffer(value, buf, buf_size_bytes);
-    if (serialization_result == JSONFailure) {
-        json_free_serialized_string(buf);
-        return NULL;
+    parson_free(writer->buf);
+    parson_free(writer);
+}
+
+/* CBOR API */
+size_t json_serialization_size_cbor(const JSON_Value *value)
+{
+    JSON_Writer writer;
+    writer_init(&writer, NULL, 0, 0);
+    if (cbor_serialize_value(value, &writer) == JSONFailure) {
+        return 0;
     }
-    return buf;
+    return writer.length;
 }
 
-size_t json_serialization_size_pretty(const JSON_Value *value)
+JSON_Status json_serialize_to_buffer_cbor(const JSON_Value *value, unsigned char *buf,
+                                          size_t buf_size_in_bytes)
 {
-    char num_buf[NUM_BUF_SIZE]; /* recursively allocating buffer on stack is a bad idea, so let's do
-                                   it only once */
-    int res = json_serialize_to_buffer_r(value, NULL, 0, 1, num_buf);
-    return res < 0 ? 0 : (size_t)(res + 1);
+    JSON_Writer writer;
+    if (buf == NULL) {
+        return JSONFailure;
+    }
+    /* The writer keeps a byte for a terminating '\0', which is never written here */
+    writer_init(&writer, (char *)buf, buf_size_in_bytes + 1, 0);
+    return cbor_serialize_value(value, &writer);
 }
 
-JSON_Status json_serialize_to_buffer_pretty(const JSON_Value *value, char *buf,
-                                            size_t buf_size_in_bytes)
+JSON_Status json_writer_serialize_cbor(JSON_Writer *writer, const JSON_Value *value)
 {
-    int written = -1;
-    size_t needed_size_in_bytes = json_serialization_size_pretty(value);
-    if (needed_size_in_bytes == 0 || buf_size_in_bytes < needed_size_in_bytes) {
+    if (writer == NULL) {
         return JSONFailure;
     }
-    written = json_serialize_to_buffer_r(value, buf, 0, 1, NULL);
-    if (written < 0) {
+    writer->length = 0;
+    if (cbor_serialize_value(value, writer) == JSONFailure ||
+        writer_reserve(writer, 0) == JSONFailure) {
+        writer->length = 0;
         return JSONFailure;
     }
+    writer_terminate(writer);
     return JSONSuccess;
 }
 
-char *json_serialize_to_string_pretty(const JSON_Value *value)
+JSON_Value *json_parse_cbor(const unsigned char *data, size_t length)
 {
-    JSON_Status serialization_result = JSONFailure;
-    size_t buf_size_bytes = json_serialization_size_pretty(value);
-    char *buf = NULL;
-    if (buf_size_bytes == 0) {
-        return NULL;
-    }
-    buf = (char *)parson_malloc(buf_size_bytes);
-    if (buf == NULL) {
+    const unsigned char *end = data + length;
+    JSON_Value *value = NULL;
+    if (data == NULL) {
         return NULL;
     }
-    serialization_result = json_serialize_to_buffer_pretty(value, buf, buf_size_bytes);
-    if (serialization_result == JSONFailure) {
-        json_free_serialized_string(buf);
+    value = cbor_parse_value(&data, end);
+    if (value != NULL && data != end) { /* trailing bytes */
+        json_value_free(value);
         return NULL;
     }
-    return buf;
-}
-
-void json_free_serialized_string(char *string)
-{
-    parson_free(string);
+    return value;
 }
 
 JSON_Status json_array_remove(JSON_Array *array, size_t ix)
@@ -1738,8 +5088,8 @@ JSON_Status json_array_remove(JSON_Array *array, size_t ix)
 
 JSON_Status json_array_replace_value(JSON_Array *array, size_t ix, JSON_Value *value)
 {
-    if (array == NULL || value == NULL || value->parent != NULL ||
-        ix >= json_array_get_count(array)) {
+    if (array == NULL || array->arena != NULL || value == NULL || value->parent != NULL ||
+        (value->flags & VALUE_FLAG_ARENA) || ix >= json_array_get_count(array)) {
         return JSONFailure;
     }
     json_value_free(json_array_get_value(array, ix));
@@ -1800,6 +5150,17 @@ JSON_Status json_array_replace_null(JSON_Array *array, size_t i)
     return JSONSuccess;
 }
 
+JSON_Status json_array_reserve(JSON_Array *array, size_t capacity)
+{
+    if (array == NULL || capacity > (size_t)-1 / sizeof(JSON_Value *)) {
+        return JSONFailure;
+    }
+    if (capacity <= array->capacity) {
+        return JSONSuccess;
+    }
+    return json_array_resize(array, capacity);
+}
+
 JSON_Status json_array_clear(JSON_Array *array)
 {
     size_t i = 0;
@@ -1815,7 +5176,8 @@ JSON_Status json_array_clear(JSON_Array *array)
 
 JSON_Status json_array_append_value(JSON_Array *array, JSON_Value *value)
 {
-    if (array == NULL || value == NULL || value->parent != NULL) {
+    if (array == NULL || array->arena != NULL || value == NULL || value->parent != NULL ||
+        (value->flags & VALUE_FLAG_ARENA)) {
         return JSONFailure;
     }
     return json_array_add(array, value);
@@ -1847,6 +5209,19 @@ JSON_Status json_array_append_number(JSON_Array *array, double number)
     return JSONSuccess;
 }
 
+JSON_Status json_array_append_number_fixed(JSON_Array *array, double number, int decimals)
+{
+    JSON_Value *value = json_value_init_number_fixed(number, decimals);
+    if (value == NULL) {
+        return JSONFailure;
+    }
+    if (json_array_append_value(array, value) == JSONFailure) {
+        json_value_free(value);
+        return JSONFailure;
+    }
+    return JSONSuccess;
+}
+
 JSON_Status json_array_append_boolean(JSON_Array *array, int boolean)
 {
     JSON_Value *value = json_value_init_boolean(boolean);
@@ -1876,20 +5251,16 @@ JSON_Status json_array_append_null(JSON_Array *array)
 JSON_Status json_object_set_value(JSON_Object *object, const char *name, JSON_Value *value)
 {
     size_t i = 0;
-    JSON_Value *old_value;
-    if (object == NULL || name == NULL || value == NULL || value->parent != NULL) {
+    if (object == NULL || object->arena != NULL || name == NULL || value == NULL ||
+        value->parent != NULL || (value->flags & VALUE_FLAG_ARENA)) {
         return JSONFailure;
     }
-    old_value = json_object_get_value(object, name);
-    if (old_value != NULL) { /* free and overwrite old value */
-        json_value_free(old_value);
-        for (i = 0; i < json_object_get_count(object); i++) {
-            if (strcmp(object->names[i], name) == 0) {
-                value->parent = json_object_get_wrapping_value(object);
-                object->values[i] = value;
-                return JSONSuccess;
-            }
-        }
+    i = json_object_getn_index(object, name, strlen(name));
+    if (i != OBJECT_INDEX_NOT_FOUND) { /* free and overwrite old value */
+        json_value_free(object->values[i]);
+        value->parent = json_object_get_wrapping_value(object);
+        object->values[i] = value;
+        return JSONSuccess;
     }
     /* add new key value pair */
     return json_object_add(object, name, value);
@@ -1897,22 +5268,53 @@ JSON_Status json_object_set_value(JSON_Object *object, const char *name, JSON_Va
 
 JSON_Status json_object_set_string(JSON_Object *object, const char *name, const char *string)
 {
-    return json_object_set_value(object, name, json_value_init_string(string));
+    JSON_Value *value = json_value_init_string(string);
+    if (json_object_set_value(object, name, value) == JSONFailure) {
+        json_value_free(value);
+        return JSONFailure;
+    }
+    return JSONSuccess;
 }
 
 JSON_Status json_object_set_number(JSON_Object *object, const char *name, double number)
 {
-    return json_object_set_value(object, name, json_value_init_number(number));
+    JSON_Value *value = json_value_init_number(number);
+    if (json_object_set_value(object, name, value) == JSONFailure) {
+        json_value_free(value);
+        return JSONFailure;
+    }
+    return JSONSuccess;
+}
+
+JSON_Status json_object_set_number_fixed(JSON_Object *object, const char *name, double number,
+                                        int decimals)
+{
+    JSON_Value *value = json_value_init_number_fixed(number, decimals);
+    if (json_object_set_value(object, name, value) == JSONFailure) {
+        json_value_free(value);
+        return JSONFailure;
+    }
+    return JSONSuccess;
 }
 
 JSON_Status json_object_set_boolean(JSON_Object *object, const char *name, int boolean)
 {
-    return json_object_set_value(object, name, json_value_init_boolean(boolean));
+    JSON_Value *value = json_value_init_boolean(boolean);
+    if (json_object_set_value(object, name, value) == JSONFailure) {
+        json_value_free(value);
+        return JSONFailure;
+    }
+    return JSONSuccess;
 }
 
 JSON_Status json_object_set_null(JSON_Object *object, const char *name)
 {
-    return json_object_set_value(object, name, json_value_init_null());
+    JSON_Value *value = json_value_init_null();
+    if (json_object_set_value(object, name, value) == JSONFailure) {
+        json_value_free(value);
+        return JSONFailure;
+    }
+    return JSONSuccess;
 }
 
 JSON_Status json_object_dotset_value(JSON_Object *object, const char *name, JSON_Value *value)
@@ -1922,7 +5324,7 @@ JSON_Status json_object_dotset_value(JSON_Object *object, const char *name, JSON
     JSON_Object *temp_object = NULL, *new_object = NULL;
     JSON_Status status = JSONFailure;
     size_t name_len = 0;
-    if (object == NULL || name == NULL || value == NULL) {
+    if (object == NULL || object->arena != NULL || name == NULL || value == NULL) {
         return JSONFailure;
     }
     dot_pos = strchr(name, '.');
@@ -1985,6 +5387,20 @@ JSON_Status json_object_dotset_number(JSON_Object *object, const char *name, dou
     return JSONSuccess;
 }
 
+JSON_Status json_object_dotset_number_fixed(JSON_Object *object, const char *name,
+                                           double number, int decimals)
+{
+    JSON_Value *value = json_value_init_number_fixed(number, decimals);
+    if (value == NULL) {
+        return JSONFailure;
+    }
+    if (json_object_dotset_value(object, name, value) == JSONFailure) {
+        json_value_free(value);
+        return JSONFailure;
+    }
+    return JSONSuccess;
+}
+
 JSON_Status json_object_dotset_boolean(JSON_Object *object, const char *name, int boolean)
 {
     JSON_Value *value = json_value_init_boolean(boolean);
@@ -2021,6 +5437,27 @@ JSON_Status json_object_dotremove(JSON_Object *object, const char *name)
     return json_object_dotremove_internal(object, name, 1);
 }
 
+JSON_Status json_object_reserve(JSON_Object *object, size_t capacity)
+{
+    size_t cell_count = OBJECT_INDEX_THRESHOLD * 4;
+    if (object == NULL || capacity > (size_t)-1 / (2 * sizeof(JSON_Object_Cell))) {
+        return JSONFailure;
+    }
+    if (capacity > object->capacity && json_object_resize(object, capacity) == JSONFailure) {
+        return JSONFailure;
+    }
+    if (capacity < OBJECT_INDEX_THRESHOLD) {
+        return JSONSuccess;
+    }
+    while (cell_count < capacity * 2) { /* the index does not grow while filling capacity */
+        cell_count *= 2;
+    }
+    if (cell_count > object->cell_count) {
+        return json_object_index_rebuild(object, cell_count);
+    }
+    return JSONSuccess;
+}
+
 JSON_Status json_object_clear(JSON_Object *object)
 {
     size_t i = 0;
@@ -2028,9 +5465,13 @@ JSON_Status json_object_clear(JSON_Object *object)
         return JSONFailure;
     }
     for (i = 0; i < json_object_get_count(object); i++) {
-        parson_free(object->names[i]);
+        json_object_free_name(object, object->names[i]);
         json_value_free(object->values[i]);
     }
+    object->borrowed_names = 0;
+    arena_free(object->arena, object->cells);
+    object->cells = NULL;
+    object->cell_count = 0;
     object->count = 0;
     return JSONSuccess;
 }
@@ -2100,7 +5541,8 @@ JSON_Status json_validate(const JSON_Value *schema, const JSON_Value *value)
     }
 }
 
-int json_value_equals(const JSON_Value *a, const JSON_Value *b)
+/* Numbers are compared exactly when exact is set, as json_value_hash hashes them */
+static int values_equal(const JSON_Value *a, const JSON_Value *b, int exact)
 {
     JSON_Object *a_object = NULL, *b_object = NULL;
     JSON_Array *a_array = NULL, *b_array = NULL;
@@ -2123,8 +5565,8 @@ int json_value_equals(const JSON_Value *a, const JSON_Value *b)
             return 0;
         }
         for (i = 0; i < a_count; i++) {
-            if (!json_value_equals(json_array_get_value(a_array, i),
-                                   json_array_get_value(b_array, i))) {
+            if (!values_equal(json_array_get_value(a_array, i),
+                              json_array_get_value(b_array, i), exact)) {
                 return 0;
             }
         }
@@ -2139,8 +5581,8 @@ int json_value_equals(const JSON_Value *a, const JSON_Value *b)
         }
         for (i = 0; i < a_count; i++) {
             key = json_object_get_name(a_object, i);
-            if (!json_value_equals(json_object_get_value(a_object, key),
-                                   json_object_get_value(b_object, key))) {
+            if (!values_equal(json_object_get_value(a_object, key),
+                              json_object_get_value(b_object, key), exact)) {
                 return 0;
             }
         }
@@ -2155,6 +5597,9 @@ int json_value_equals(const JSON_Value *a, const JSON_Value *b)
     case JSONBoolean:
         return json_value_get_boolean(a) == json_value_get_boolean(b);
     case JSONNumber:
+        if (exact) {
+            return json_value_get_number(a) == json_value_get_number(b);
+        }
         return fabs(json_value_get_number(a) - json_value_get_number(b)) < 0.000001; /* EPSILON */
     case JSONError:
         return 1;
@@ -2165,6 +5610,180 @@ int json_value_equals(const JSON_Value *a, const JSON_Value *b)
     }
 }
 
+int json_value_equals(const JSON_Value *a, const JSON_Value *b)
+{
+    return values_equal(a, b, 0);
+}
+
+/* Merge patch */
+static JSON_Status merge_patch_object(JSON_Object *target, const JSON_Object *patch)
+{
+    JSON_Value *patch_value = NULL, *target_value = NULL, *new_value = NULL;
+    const char *name = NULL;
+    size_t i = 0;
+    for (i = 0; i < json_object_get_count(patch); i++) {
+        name = json_object_get_name(patch, i);
+        patch_value = json_object_get_value_at(patch, i);
+        switch (json_value_get_type(patch_value)) {
+        case JSONNull:
+            json_object_remove(target, name); /* fails when there is nothing to remove */
+            break;
+        case JSONObject:
+            target_value = json_object_get_value(target, name);
+            if (json_value_get_type(target_value) != JSONObject) {
+                target_value = json_value_init_object();
+                if (json_object_set_value(target, name, target_value) == JSONFailure) {
+                    json_value_free(target_value);
+                    return JSONFailure;
+                }
+            }
+            if (merge_patch_object(json_value_get_object(target_value),
+                                   json_value_get_object(patch_value)) == JSONFailure) {
+                return JSONFailure;
+            }
+            break;
+        default:
+            new_value = json_value_deep_copy(patch_value);
+            if (new_value == NULL) {
+                return JSONFailure;
+            }
+            if (json_object_set_value(target, name, new_value) == JSONFailure) {
+                json_value_free(new_value);
+                return JSONFailure;
+            }
+            break;
+        }
+    }
+    return JSONSuccess;
+}
+
+JSON_Status json_merge_patch(JSON_Value *target, const JSON_Value *patch)
+{
+    if (json_value_get_type(target) != JSONObject || json_value_get_type(patch) != JSONObject) {
+        return JSONFailure;
+    }
+    return merge_patch_object(json_value_get_object(target), json_value_get_object(patch));
+}
+
+/* Adds to patch the members that turn old_object into new_object */
+static JSON_Status diff_object(const JSON_Object *old_object, const JSON_Object *new_object,
+                               JSON_Object *patch)
+{
+    JSON_Value *old_value = NULL, *new_value = NULL, *patch_value = NULL;
+    const char *name = NULL;
+    size_t i = 0;
+    for (i = 0; i < json_object_get_count(old_object); i++) {
+        name = json_object_get_name(old_object, i);
+        if (json_object_get_value(new_object, name) == NULL &&
+            json_object_set_null(patch, name) == JSONFailure) {
+            return JSONFailure;
+        }
+    }
+    for (i = 0; i < json_object_get_count(new_object); i++) {
+        name = json_object_get_name(new_object, i);
+        new_value = json_object_get_value_at(new_object, i);
+        old_value = json_object_get_value(old_object, name);
+        if (json_value_get_type(old_value) == JSONObject &&
+            json_value_get_type(new_value) == JSONObject) {
+            /* diffed without comparing first, an empty patch means they are equal */
+            patch_value = json_value_init_object();
+            if (patch_value == NULL ||
+                diff_object(json_value_get_object(old_value), json_value_get_object(new_value),
+                            json_value_get_object(patch_value)) == JSONFailure) {
+                json_value_free(patch_value);
+                return JSONFailure;
+            }
+            if (json_object_get_count(json_value_get_object(patch_value)) == 0) {
+                json_value_free(patch_value);
+                continue;
+            }
+        } else if (json_value_hash(old_value) == json_value_hash(new_value) &&
+                   values_equal(old_value, new_value, 1)) {
+            continue; /* hashes that differ tell changes apart without comparing */
+        } else {
+            patch_value = json_value_deep_copy(new_value);
+            if (patch_value == NULL) {
+                return JSONFailure;
+            }
+        }
+        if (json_object_set_value(patch, name, patch_value) == JSONFailure) {
+            json_value_free(patch_value);
+            return JSONFailure;
+        }
+    }
+    return JSONSuccess;
+}
+
+JSON_Value *json_diff(const JSON_Value *old_value, const JSON_Value *new_value)
+{
+    JSON_Value *patch = NULL;
+    if (json_value_get_type(old_value) != JSONObject ||
+        json_value_get_type(new_value) != JSONObject) {
+        return NULL;
+    }
+    patch = json_value_init_object();
+    if (patch == NULL) {
+        return NULL;
+    }
+    if (diff_object(json_value_get_object(old_value), json_value_get_object(new_value),
+                    json_value_get_object(patch)) == JSONFailure) {
+        json_value_free(patch);
+        return NULL;
+    }
+    return patch;
+}
+
+/* Hashing */
+/* Spreads every bit of hash over the others, also when unsigned long is 32-bit */
+static unsigned long hash_mix(unsigned long hash)
+{
+    hash ^= hash >> 16;
+    hash *= 0x45d9f3bUL;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+unsigned long json_value_hash(const JSON_Value *value)
+{
+    JSON_Object *object = NULL;
+    JSON_Array *array = NULL;
+    const char *string = NULL;
+    unsigned long hash = hash_mix((unsigned long)json_value_get_type(value)), members = 0;
+    unsigned char bytes[sizeof(double)];
+    double number = 0;
+    size_t i = 0;
+    switch (json_value_get_type(value)) {
+    case JSONObject: /* members are summed, so that their order does not matter */
+        object = json_value_get_object(value);
+        for (i = 0; i < json_object_get_count(object); i++) {
+            string = json_object_get_name(object, i);
+            members += hash_mix(hash_string(string, strlen(string)) ^
+                                json_value_hash(json_object_get_value_at(object, i)));
+        }
+        return hash_mix(hash + members);
+    case JSONArray:
+        array = json_value_get_array(value);
+        for (i = 0; i < json_array_get_count(array); i++) {
+            hash = hash_mix(hash * 31 + json_value_hash(json_array_get_value(array, i)));
+        }
+        return hash;
+    case JSONString:
+        string = json_value_get_string(value);
+        return hash_mix(hash ^ hash_string(string, strlen(string)));
+    case JSONNumber:
+        number = json_value_get_number(value);
+        if (number == 0) {
+            number = 0; /* -0 equals 0 */
+        }
+        memcpy(bytes, &number, sizeof(double));
+        return hash_mix(hash ^ hash_string((const char *)bytes, sizeof(double)));
+    case JSONBoolean:
+        return hash_mix(hash ^ (unsigned long)json_value_get_boolean(value));
+    default:
+        return hash;
+    }
+}
+
 JSON_Value_Type json_type(const JSON_Value *value)
 {
     return json_value_get_type(value);
@@ -2200,3 +5819,94 @@ void json_set_allocation_functions(JSON_Malloc_Function malloc_fun, JSON_Free_Fu
     parson_malloc = malloc_fun;
     parson_free = free_fun;
 }
+
+JSON_Intern_Table *json_intern_table_create(void)
+{
+    JSON_Intern_Table *table = (JSON_Intern_Table *)parson_malloc(sizeof(JSON_Intern_Table));
+    if (table == NULL) {
+        return NULL;
+    }
+    table->cells = NULL;
+    table->cell_count = 0;
+    table->count = 0;
+    return table;
+}
+
+void json_intern_table_free(JSON_Intern_Table *table)
+{
+    size_t i;
+    if (table == NULL) {
+        return;
+    }
+    for (i = 0; i < table->cell_count; i++) {
+        parson_free(table->cells[i].name);
+    }
+    parson_free(table->cells);
+    parson_free(table);
+}
+
+void json_intern_table_clear(JSON_Intern_Table *table)
+{
+    size_t i;
+    if (table == NULL) {
+        return;
+    }
+    for (i = 0; i < table->cell_count; i++) {
+        parson_free(table->cells[i].name);
+        table->cells[i].name = NULL;
+    }
+    table->count = 0;
+}
+
+void json_set_intern_table(JSON_Intern_Table *table)
+{
+    parson_intern_table = table;
+}
+
+void json_set_nesting_limit(size_t limit)
+{
+    parson_nesting_limit = limit;
+}
+
+JSON_Arena *json_arena_create(size_t block_size)
+{
+    JSON_Arena *arena = (JSON_Arena *)parson_malloc(sizeof(JSON_Arena));
+    if (arena == NULL) {
+        return NULL;
+    }
+    arena->blocks = NULL;
+    arena->block_size = ARENA_ALIGN(block_size > 0 ? block_size : ARENA_DEFAULT_BLOCK_SIZE);
+    return arena;
+}
+
+void json_arena_reset(JSON_Arena *arena)
+{
+    JSON_Arena_Block *block = NULL, *kept = NULL;
+    if (arena == NULL) {
+        return;
+    }
+    while (arena->blocks != NULL) { /* keep one regular block around for the next document */
+        block = arena->blocks;
+        arena->blocks = block->next;
+        if (kept == NULL && block->size == arena->block_size) {
+            kept = block;
+        } else {
+            parson_free(block);
+        }
+    }
+    if (kept != NULL) {
+        kept->next = NULL;
+        kept->used = 0;
+    }
+    arena->blocks = kept;
+}
+
+void json_arena_free(JSON_Arena *arena)
+{
+    if (arena == NULL) {
+        return;
+    }
+    json_arena_reset(arena);
+    parson_free(arena->blocks);
+    parson_free(arena);
+}
@@ -41,6 +41,11 @@ extern "C" {
 typedef struct json_object_t JSON_Object;
 typedef struct json_array_t JSON_Array;
 typedef struct json_value_t JSON_Value;
+typedef struct json_arena_t JSON_Arena;
+typedef struct json_writer_t JSON_Writer;
+typedef struct json_path_t JSON_Path;
+typedef struct json_intern_table_t JSON_Intern_Table;
+typedef struct json_stream_t JSON_Stream;
 
 enum json_value_type {
     JSONError = -1,
@@ -59,34 +64,236 @@ typedef int JSON_Status;
 typedef void *(*JSON_Malloc_Function)(size_t);
 typedef void (*JSON_Free_Function)(void *);
 
+/* Receives serialized output piece by piece, returns JSONFailure to abort serialization */
+typedef JSON_Status (*JSON_Sink_Function)(const char *data, size_t length, void *context);
+
 /* Call only once, before calling any other function from parson API. If not called, malloc and free
    from stdlib will be used for all allocations */
 void json_set_allocation_functions(JSON_Malloc_Function malloc_fun, JSON_Free_Function free_fun);
 
-/*  Parses first JSON value in a string, returns NULL in case of error */
+/* Inputs with containers nested deeper than limit are rejected by every parser, 2048 by default.
+   Parsing, event parsing, decoding into structs, serializing to text or CBOR and freeing do not
+   recurse, so the depth of a document costs them no C stack. Copying, comparing, hashing,
+   validating and patching values take a stack frame per level. */
+void json_set_nesting_limit(size_t limit);
+
+/*  Parses first JSON value in a string, returns NULL in case of error, including strings that
+    are not valid UTF-8 */
 JSON_Value *json_parse_string(const char *string);
 
 /*  Parses first JSON value in a string and ignores comments (/ * * / and //),
     returns NULL in case of error */
 JSON_Value *json_parse_string_with_comments(const char *string);
 
+/*  Same as above, but parse the first length bytes of data, which need not be NUL-terminated */
+JSON_Value *json_parse_buffer(const char *data, size_t length);
+JSON_Value *json_parse_buffer_with_comments(const char *data, size_t length);
+
+/* Arenas
+   Every value, object, array, name and string of a document parsed into an arena is carved out of
+   a few large blocks, and the whole document is released at once by json_arena_reset or
+   json_arena_free, except for names shared from an intern table. json_value_free does nothing
+   on such values. Documents in an arena are read-only: values can be read and removed, but
+   adding or replacing values fails with JSONFailure. */
+JSON_Arena *json_arena_create(size_t block_size); /* 0 selects the default block size */
+void json_arena_reset(JSON_Arena *arena); /* invalidates all values parsed into the arena */
+void json_arena_free(JSON_Arena *arena);
+
+/* Name interning
+   Objects created while an intern table is set share their names from it instead of copying
+   them, so documents repeating the same names stop allocating names once all have been seen.
+   Names stay in the table until it is cleared or freed, which must not happen before every
+   object created while it was set is freed. The table never evicts names by itself, so a table
+   kept across documents whose names come from outside grows with every new name; set it only
+   around the parses that benefit and clear it when their documents are freed. The table is not
+   thread-safe. */
+JSON_Intern_Table *json_intern_table_create(void);
+void json_intern_table_free(JSON_Intern_Table *table);
+void json_intern_table_clear(JSON_Intern_Table *table); /* frees the names, keeps the cells */
+void json_set_intern_table(JSON_Intern_Table *table); /* NULL stops interning */
+
+/*  Same as json_parse_string, but allocates the document from arena (from the heap if NULL) */
+JSON_Value *json_parse_string_arena(JSON_Arena *arena, const char *string);
+JSON_Value *json_parse_buffer_arena(JSON_Arena *arena, const char *data, size_t length);
+
+/*  Parses in situ: strings and names are unescaped inside the passed buffer and point into it
+    instead of being copied, so the buffer is modified and must outlive the returned value. */
+JSON_Value *json_parse_string_insitu(char *string);
+JSON_Value *json_parse_string_insitu_arena(JSON_Arena *arena, char *string);
+
+/*  Parses lazily: a single pass validates the input and indexes where every object and array
+    starts and ends. The members of a container are only parsed when it is first reached through
+    json_value_get_object or json_value_get_array, which every getter goes through, and the
+    containers among them stay unparsed until reached in turn. Subtrees that are never read cost
+    nothing but their entries in the index. The input is copied. Duplicate names are only detected
+    when their object is reached, getters then return NULL as when memory runs out. Reading the
+    document modifies it, json_value_get_object and json_value_get_array included although they
+    take a const value, so it must not be read from several threads at once. Names of lazily
+    parsed objects are never interned, whatever intern table is set when they are reached. */
+JSON_Value *json_parse_string_lazy(const char *string);
+JSON_Value *json_parse_buffer_lazy(const char *data, size_t length);
+
+/* Event parsing
+   json_parse_events walks data without building any value and calls handler for every token.
+   Strings are not unescaped or copied: event->string points into data, between the quotes.
+   Nothing is allocated, except for numbers longer than 63 characters. Duplicate names are not
+   detected. The handler returns 0 to stop parsing, which is not an error. */
+enum json_event_type {
+    JSONEventStartObject = 1,
+    JSONEventEndObject = 2,
+    JSONEventStartArray = 3,
+    JSONEventEndArray = 4,
+    JSONEventKey = 5,
+    JSONEventString = 6,
+    JSONEventNumber = 7,
+    JSONEventBoolean = 8,
+    JSONEventNull = 9
+};
+typedef int JSON_Event_Type;
+
+typedef struct json_event_t {
+    JSON_Event_Type type;
+    size_t depth;       /* containers around the token, 0 for the root value and its brackets */
+    const char *string; /* escaped text of keys and strings, text of numbers, or the bracket */
+    size_t length;      /* length of string, not NUL-terminated */
+    double number;
+    int boolean;
+} JSON_Event;
+
+typedef int (*JSON_Event_Handler)(const JSON_Event *event, void *context);
+
+JSON_Status json_parse_events(const char *data, size_t length, JSON_Event_Handler handler,
+                              void *context);
+
+/* Unescapes a key or string event into buf, which must hold at least event->length + 1 bytes */
+JSON_Status json_event_get_string(const JSON_Event *event, char *buf, size_t buf_size_in_bytes);
+
+/* Incremental parsing
+   A stream parses values fed in chunks of any size, keeping partial tokens between calls, so
+   input arriving piecewise needs no assembling. json_stream_feed stops right after a complete
+   value and reports in consumed how many bytes it read, the rest of the chunk is fed again for
+   the next value. A number at the root is complete once the character following it is fed.
+   Errors are sticky until json_stream_reset. */
+enum json_stream_status {
+    JSONStreamError = -1,
+    JSONStreamIncomplete = 0, /* every byte was read, the value goes on in the next chunk */
+    JSONStreamComplete = 1    /* the value can be taken with json_stream_take_value */
+};
+typedef int JSON_Stream_Status;
+
+JSON_Stream *json_stream_create(void);
+JSON_Stream_Status json_stream_feed(JSON_Stream *stream, const char *data, size_t length,
+                                    size_t *consumed);
+/* Returns the complete value, to be freed by the caller, and starts reading the next one */
+JSON_Value *json_stream_take_value(JSON_Stream *stream);
+/* Drops the partial value and any error */
+void json_stream_reset(JSON_Stream *stream);
+void json_stream_free(JSON_Stream *stream);
+
+/* Decoding into structs
+   json_decode_buffer walks data like json_parse_events and stores the values found at the paths
+   of fields into the members of a caller-owned struct, without building any value. Paths use the
+   dot notation of dotget functions, from the root object. Strings are unescaped into char arrays,
+   which must hold the escaped string and its terminating '\0'. When a name is duplicated, the
+   last value wins. */
+enum json_field_type {
+    JSONFieldString = 1,  /* char[size] */
+    JSONFieldNumber = 2,  /* double */
+    JSONFieldBoolean = 3  /* int */
+};
+typedef int JSON_Field_Type;
+
+enum json_field_status {
+    JSONFieldMissing = 0,
+    JSONFieldDecoded = 1,
+    JSONFieldMistyped = 2, /* the value has another type, the member was not written */
+    JSONFieldTooLong = 3,  /* the string does not fit, the member was not written */
+    JSONFieldInvalid = 4   /* data is not valid JSON, the member may have been written anyway */
+};
+typedef int JSON_Field_Status;
+
+typedef struct json_field_t {
+    const char *path;
+    JSON_Field_Type type;
+    size_t offset; /* offsetof the member */
+    size_t size;   /* sizeof the member */
+} JSON_Field;
+
+/* Returns JSONSuccess when data is valid and every field was decoded. statuses must hold
+   field_count entries and receives the status of every field, also on failure. When data is not
+   valid JSON every status is JSONFieldInvalid, whatever was found before the error. */
+JSON_Status json_decode_buffer(const char *data, size_t length, const JSON_Field *fields,
+                               size_t field_count, void *target, JSON_Field_Status *statuses);
+
 /* Serialization */
 size_t json_serialization_size(const JSON_Value *value); /* returns 0 on fail */
 JSON_Status json_serialize_to_buffer(const JSON_Value *value, char *buf, size_t buf_size_in_bytes);
 char *json_serialize_to_string(const JSON_Value *value);
+/* Streams the output to sink through a small buffer on the stack, so that no memory is allocated
+   whatever the size of value. Chunks are not terminated and at most 128 bytes long. When
+   serialization fails, part of the output may have been written already. */
+JSON_Status json_serialize_to_sink(const JSON_Value *value, JSON_Sink_Function sink,
+                                   void *context);
 
 /* Pretty serialization */
 size_t json_serialization_size_pretty(const JSON_Value *value); /* returns 0 on fail */
 JSON_Status json_serialize_to_buffer_pretty(const JSON_Value *value, char *buf,
                                             size_t buf_size_in_bytes);
 char *json_serialize_to_string_pretty(const JSON_Value *value);
+JSON_Status json_serialize_to_sink_pretty(const JSON_Value *value, JSON_Sink_Function sink,
+                                          void *context);
 
 void json_free_serialized_string(char *string); /* frees string from json_serialize_to_string and
                                                    json_serialize_to_string_pretty */
 
-/* Comparing */
+/* Writers
+   A writer owns a buffer that grows as needed and is reused by every serialization into it, so
+   serializing repeatedly does not allocate once the buffer is large enough. The string is valid
+   until the next serialization into the writer or until it is freed. */
+JSON_Writer *json_writer_create(size_t initial_capacity); /* 0 allocates on first use */
+JSON_Status json_writer_serialize(JSON_Writer *writer, const JSON_Value *value);
+JSON_Status json_writer_serialize_pretty(JSON_Writer *writer, const JSON_Value *value);
+const char *json_writer_get_string(const JSON_Writer *writer);
+size_t json_writer_get_length(const JSON_Writer *writer); /* without the terminating '\0' */
+void json_writer_free(JSON_Writer *writer);
+
+/* CBOR (RFC 8949)
+   Values are encoded to binary CBOR and decoded from it directly, without going through text.
+   Integral numbers are encoded as integers and other numbers as single precision floats when
+   that is exact, as double precision ones otherwise. Decoding takes one data item of definite
+   length, with text strings for names, and skips tags. Byte strings, text containing '\0',
+   undefined and non-finite floats are rejected. The media type is "application/cbor". */
+size_t json_serialization_size_cbor(const JSON_Value *value); /* returns 0 on fail */
+JSON_Status json_serialize_to_buffer_cbor(const JSON_Value *value, unsigned char *buf,
+                                          size_t buf_size_in_bytes);
+/* The encoding is json_writer_get_length bytes long, it can contain '\0' */
+JSON_Status json_writer_serialize_cbor(JSON_Writer *writer, const JSON_Value *value);
+JSON_Value *json_parse_cbor(const unsigned char *data, size_t length);
+
+/* Comparing
+   Numbers closer than 0.000001 are taken as equal. */
 int json_value_equals(const JSON_Value *a, const JSON_Value *b);
 
+/* Structural hash: values with the same structure and contents hash the same, whatever the order
+   of the members of their objects. Numbers are hashed exactly, so numbers that json_value_equals
+   takes as equal because they are closer than its epsilon can hash differently: hashes that
+   differ only prove values unequal when numbers are compared exactly, as json_diff does. */
+unsigned long json_value_hash(const JSON_Value *value);
+
+/* Merge patch (RFC 7396)
+   Applies patch to target in place: null members of patch remove those of target, object
+   members are merged recursively and other members replace those of target. Both values must be
+   objects, patch is copied, not moved. A failure can leave target partly patched. */
+JSON_Status json_merge_patch(JSON_Value *target, const JSON_Value *patch);
+
+/* Returns the smallest merge patch turning old_value into new_value, an empty object when they
+   are equal, or NULL on failure. Both values must be objects. Members that changed are copied
+   whole, except objects, which are diffed recursively. Numbers are compared exactly, unlike in
+   json_value_equals, and json_value_hash tells most changed members apart without comparing
+   them. Null members of new_value cannot be told apart from removed ones in a merge patch and are
+   diffed as such. */
+JSON_Value *json_diff(const JSON_Value *old_value, const JSON_Value *new_value);
+
 /* Validation
    This is *NOT* JSON Schema. It validates json by checking if object have identically
    named fields with matching types.
@@ -122,6 +329,19 @@ double json_object_dotget_number(const JSON_Object *object,
 int json_object_dotget_boolean(const JSON_Object *object,
                                const char *name); /* returns -1 on fail */
 
+/* Compiled paths address the same values as dotget functions, but split the dotted name and hash
+   its segments once, so looking up a path queried often costs no more than the name lookups. */
+JSON_Path *json_path_compile(const char *name); /* returns NULL on fail */
+void json_path_free(JSON_Path *path);
+JSON_Value *json_path_get_value(const JSON_Object *object, const JSON_Path *path);
+const char *json_path_get_string(const JSON_Object *object, const JSON_Path *path);
+JSON_Object *json_path_get_object(const JSON_Object *object, const JSON_Path *path);
+JSON_Array *json_path_get_array(const JSON_Object *object, const JSON_Path *path);
+double json_path_get_number(const JSON_Object *object,
+                            const JSON_Path *path); /* returns 0 on fail */
+int json_path_get_boolean(const JSON_Object *object,
+                          const JSON_Path *path); /* returns -1 on fail */
+
 /* Functions to get available names */
 size_t json_object_get_count(const JSON_Object *object);
 const char *json_object_get_name(const JSON_Object *object, size_t index);
@@ -143,6 +363,8 @@ int json_object_dothas_value_of_type(const JSON_Object *object, const char *name
 JSON_Status json_object_set_value(JSON_Object *object, const char *name, JSON_Value *value);
 JSON_Status json_object_set_string(JSON_Object *object, const char *name, const char *string);
 JSON_Status json_object_set_number(JSON_Object *object, const char *name, double number);
+JSON_Status json_object_set_number_fixed(JSON_Object *object, const char *name, double number,
+                                        int decimals);
 JSON_Status json_object_set_boolean(JSON_Object *object, const char *name, int boolean);
 JSON_Status json_object_set_null(JSON_Object *object, const char *name);
 
@@ -151,6 +373,8 @@ JSON_Status json_object_set_null(JSON_Object *object, const char *name);
 JSON_Status json_object_dotset_value(JSON_Object *object, const char *name, JSON_Value *value);
 JSON_Status json_object_dotset_string(JSON_Object *object, const char *name, const char *string);
 JSON_Status json_object_dotset_number(JSON_Object *object, const char *name, double number);
+JSON_Status json_object_dotset_number_fixed(JSON_Object *object, const char *name,
+                                           double number, int decimals);
 JSON_Status json_object_dotset_boolean(JSON_Object *object, const char *name, int boolean);
 JSON_Status json_object_dotset_null(JSON_Object *object, const char *name);
 
@@ -163,6 +387,9 @@ JSON_Status json_object_dotremove(JSON_Object *object, const char *key);
 /* Removes all name-value pairs in object */
 JSON_Status json_object_clear(JSON_Object *object);
 
+/* Makes room for capacity name-value pairs in total, so that adding them does not reallocate */
+JSON_Status json_object_reserve(JSON_Object *object, size_t capacity);
+
 /*
  *JSON Array
  */
@@ -191,11 +418,15 @@ JSON_Status json_array_replace_null(JSON_Array *array, size_t i);
 /* Frees and removes all values from array */
 JSON_Status json_array_clear(JSON_Array *array);
 
+/* Makes room for capacity values in total, so that appending them does not reallocate */
+JSON_Status json_array_reserve(JSON_Array *array, size_t capacity);
+
 /* Appends new value at the end of array.
  * json_array_append_value does not copy passed value so it shouldn't be freed afterwards. */
 JSON_Status json_array_append_value(JSON_Array *array, JSON_Value *value);
 JSON_Status json_array_append_string(JSON_Array *array, const char *string);
 JSON_Status json_array_append_number(JSON_Array *array, double number);
+JSON_Status json_array_append_number_fixed(JSON_Array *array, double number, int decimals);
 JSON_Status json_array_append_boolean(JSON_Array *array, int boolean);
 JSON_Status json_array_append_null(JSON_Array *array);
 
@@ -206,12 +437,18 @@ JSON_Value *json_value_init_object(void);
 JSON_Value *json_value_init_array(void);
 JSON_Value *json_value_init_string(const char *string); /* copies passed string */
 JSON_Value *json_value_init_number(double number);
+JSON_Value *json_value_init_number_fixed(double number, int decimals); /* see below */
 JSON_Value *json_value_init_boolean(int boolean);
 JSON_Value *json_value_init_null(void);
 JSON_Value *json_value_deep_copy(const JSON_Value *value);
 void json_value_free(JSON_Value *value);
 
+/* Releases the spare room of every object and array in value, e.g. before keeping a document
+   for long. Values allocated in an arena are left as they are. */
+JSON_Status json_value_shrink_to_fit(JSON_Value *value);
+
 JSON_Value_Type json_value_get_type(const JSON_Value *value);
+/* Both parse the members of a lazily parsed container on first call, modifying value */
 JSON_Object *json_value_get_object(const JSON_Value *value);
 JSON_Array *json_value_get_array(const JSON_Value *value);
 const char *json_value_get_string(const JSON_Value *value);
@@ -219,6 +456,14 @@ double json_value_get_number(const JSON_Value *value);
 int json_value_get_boolean(const JSON_Value *value);
 JSON_Value *json_value_get_parent(const JSON_Value *value);
 
+/* Numbers can be given the count of decimals they are serialized with, from 0 to 15, e.g. 2 for
+   sensor readings. They are then rounded half up and written in plain notation, without trailing
+   zeros: 21.456 with 2 decimals as 21.46 and 20.0 as 20. The value itself is not rounded.
+   Numbers too large for that many decimals (|number| * 10^decimals >= 2^53) are written as usual.
+   Copies keep the decimals, comparing, hashing and CBOR ignore them. -1 means none is set. */
+JSON_Status json_value_set_number_decimals(JSON_Value *value, int decimals);
+int json_value_get_number_decimals(const JSON_Value *value); /* returns -1 when none is set */
+
 /* Same as above, but shorter */
 JSON_Value_Type json_type(const JSON_Value *value);
 JSON_Object *json_object(const JSON_Value *value);